@@ -37,6 +37,8 @@ CREATE TABLE `Character_DATA` (
   `Model` varchar(64) NOT NULL DEFAULT '"Survivor2_DZ"',
   `KillsB` int(11) UNSIGNED NOT NULL DEFAULT '0',
   `Humanity` int(11) NOT NULL DEFAULT '2500',
+  `Money` int(11) NOT NULL DEFAULT '0',
+  `MoneySeq` bigint(20) UNSIGNED NOT NULL DEFAULT '0',
   PRIMARY KEY (`CharacterID`),
   KEY `CharFetch` (`PlayerUID`,`Alive`) USING BTREE
 ) ENGINE=InnoDB AUTO_INCREMENT=1 DEFAULT CHARSET=latin1;
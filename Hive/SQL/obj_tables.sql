@@ -15,8 +15,20 @@ CREATE TABLE `Object_DATA` (
   `Hitpoints` varchar(512) NOT NULL DEFAULT '[]',
   `Fuel` double(13,5) NOT NULL DEFAULT '1.00000',
   `Damage` double(13,5) NOT NULL DEFAULT '0.00000',
+  `Money` int(11) NOT NULL DEFAULT '0',
+  `MoneySeq` bigint(20) UNSIGNED NOT NULL DEFAULT '0',
   `last_updated` timestamp NOT NULL DEFAULT CURRENT_TIMESTAMP ON UPDATE CURRENT_TIMESTAMP,
   PRIMARY KEY (`ObjectID`),
   KEY `ObjectUID` (`ObjectUID`),
   KEY `Instance` (`Instance`)
 ) ENGINE=InnoDB AUTO_INCREMENT=1 DEFAULT CHARSET=latin1;
+
+-- ----------------------------
+-- Table structure for `Object_SEQUENCE`
+-- (only used with IDBlockSize set in HiveExt.ini)
+-- ----------------------------
+CREATE TABLE `Object_SEQUENCE` (
+  `Name` varchar(64) NOT NULL,
+  `NextID` int(11) UNSIGNED NOT NULL DEFAULT '1',
+  PRIMARY KEY (`Name`)
+) ENGINE=InnoDB DEFAULT CHARSET=latin1;
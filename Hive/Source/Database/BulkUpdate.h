@@ -0,0 +1,48 @@
+/*
+* Copyright (C) 2009-2012 Rajko Stojadinovic <http://github.com/rajkosto/hive>
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*/
+
+#pragma once
+
+#include "Shared/Common/Types.h"
+
+//Many rows of one table updated by their key, sent as few multi-row statements as possible
+//keys, values and filters are SQL literals, already escaped (and quoted, for strings)
+struct BulkUpdate
+{
+	BulkUpdate(std::string table, std::string key) : tableName(std::move(table)), keyColumn(std::move(key)) {}
+
+	std::string tableName;
+	std::string keyColumn;
+	std::vector<std::string> columns;
+	//extra column = value conditions every row must match
+	std::vector< std::pair<std::string,std::string> > filters;
+
+	struct Row
+	{
+		std::string key;
+		std::vector<std::string> values; //same order as columns
+	};
+	std::vector<Row> rows;
+
+	void addRow(std::string key, std::vector<std::string> values)
+	{
+		rows.push_back(Row());
+		rows.back().key = std::move(key);
+		rows.back().values = std::move(values);
+	}
+};
@@ -23,6 +23,7 @@
 #include "QueryResult.h"
 #include "SqlStatement.h"
 #include "Callback.h"
+#include "BulkUpdate.h"
 
 namespace Poco { class Logger; };
 
@@ -46,7 +47,18 @@ public:
 	virtual unique_ptr<QueryResult> queryParams(const char* format,...) = 0;
 	virtual unique_ptr<QueryNamedResult> namedQueryParams(const char* format,...) = 0;
 
+	//Synchronous streamed queries, rows are read off the wire as they are fetched instead of being buffered
+	//the connection stays busy until the result is destroyed, so don't issue other queries from this thread meanwhile
+	virtual unique_ptr<QueryResult> queryStreamed(const char* sql) = 0;
+	virtual unique_ptr<QueryResult> queryStreamedParams(const char* format,...) = 0;
+	//streamed query on one particular connection of the pool, so streams running side by side don't wait on each other
+	virtual unique_ptr<QueryResult> queryStreamedOn(size_t connIdx, const char* sql) = 0;
+	//number of connections queryStreamedOn can pick from
+	virtual size_t queryConnections() const = 0;
+
 	virtual bool directExecute(const char* sql) = 0;
+	//also tells how many rows the statement changed
+	virtual bool directExecute(const char* sql, UInt64& affectedRows) = 0;
 	virtual bool directExecuteParams(const char* format,...) = 0;
 
 	//Query creation helpers
@@ -54,6 +66,8 @@ public:
 	virtual std::string sqlTableSim(const std::string& tableName) const = 0;
 	virtual std::string sqlConcat(const std::string& a, const std::string& b, const std::string& c) const = 0;
 	virtual std::string sqlOffset() const = 0;
+	//statement updating rows [firstRow,endRow) of update
+	virtual std::string sqlBulkUpdate(const BulkUpdate& update, size_t firstRow, size_t endRow) const = 0;
 
 	//Async queries and query holders
 	virtual bool asyncQuery(QueryCallback::FuncType func, const char* sql) = 0;
@@ -61,6 +75,12 @@ public:
 
 	virtual bool execute(const char* sql) = 0;
 	virtual bool executeParams(const char* format,...) = 0;
+	//Async write that only runs when no other async writes are waiting, for audit records and the like
+	virtual bool executeLowPriority(const char* sql) = 0;
+
+	//Async multi-row update, split into as few statements as the server will take
+	//returns the number of statements queued, 0 on failure
+	virtual size_t executeBulkUpdate(const BulkUpdate& update) = 0;
 
 	//Writes SQL commands to a LOG file
 	virtual bool executeParamsLog(const char* format,...) = 0;
@@ -70,6 +90,8 @@ public:
 	virtual bool transactionRollback() = 0;
 	//for sync transaction execution
 	virtual bool transactionCommitDirect() = 0;
+	//whether this thread has started a transaction that hasn't been committed or rolled back
+	virtual bool transactionActive() const = 0;
 
 	//PREPARED STATEMENT API
 
@@ -93,6 +115,51 @@ public:
 	//Check if connection to DB is alive and well
 	virtual bool checkConnections() = 0;
 
+	//Record async writes in a journal file, after running whatever a previous run left unfinished in it
+	//the file is flushed to disk every syncInterval ms
+	virtual bool openJournal(const std::string& fileName, UInt32 syncInterval) = 0;
+
+	//Degraded mode: when the database can't be reached, queries fail right away and async writes are held in order
+	//how long (in ms) it has been unreachable, 0 if it's up
+	virtual UInt32 outageDuration() const = 0;
+	//async operations waiting to be run
+	virtual size_t pendingOperations() const = 0;
+	//async operations that failed while the database was up, and won't be run again
+	//anything that remembers what it has written can't trust it anymore once this goes up
+	virtual UInt32 droppedOperations() const = 0;
+
 	//Call this once you're out of global constructor code/DLLMain
 	virtual void allowAsyncOperations() = 0;
+};
+
+//All the async writes this thread makes while it's in scope go out as one transaction, committed when it ends
+//does nothing if the thread is already in a transaction, so they can be nested
+//the writes are committed even if the scope is left by an exception, since whoever made them already counts on them
+class UnitOfWork : public boost::noncopyable
+{
+public:
+	explicit UnitOfWork(Database& db) : _db(db), _active(!db.transactionActive() && db.transactionStart()) {}
+	~UnitOfWork() { commit(); }
+
+	//sends what was written so far, instead of waiting for the end of the scope
+	bool commit()
+	{
+		if (!_active)
+			return true;
+
+		_active = false;
+		return _db.transactionCommit();
+	}
+	//throws away what was written so far
+	void rollback()
+	{
+		if (!_active)
+			return;
+
+		_active = false;
+		_db.transactionRollback();
+	}
+private:
+	Database& _db;
+	bool _active;
 };
\ No newline at end of file
@@ -20,6 +20,7 @@
 #include "SqlOperations.h"
 #include "SqlConnection.h"
 #include "SqlStatementImpl.h"
+#include "Shared/Common/Timer.h"
 
 #include <ctime>
 #include <iostream>
@@ -28,10 +29,13 @@
 
 static const size_t MIN_CONNECTION_POOL_SIZE = 1;
 static const size_t MAX_CONNECTION_POOL_SIZE = 16;
+//times a journalled write is tried at startup while the database is unreachable, before giving up on starting
+static const int JOURNAL_REPLAY_ATTEMPTS = 3;
 
 //////////////////////////////////////////////////////////////////////////
 
-ConcreteDatabase::ConcreteDatabase() : _shouldLogSQL(false), _currConn(0), _asyncAllowed(false), _logger(nullptr)
+ConcreteDatabase::ConcreteDatabase() : _shouldLogSQL(false), _currConn(0), _asyncAllowed(false), _maxStatementLen(1024*1024), 
+	_reconnectAttempts(3), _outageRetryInterval(5000), _down(false), _outageStart(0), _lastProbe(0), _maxHeldOperations(100000), _logger(nullptr)
 {
 }
 
@@ -58,6 +62,38 @@ bool ConcreteDatabase::initialise(Poco::Logger& dbLogger, const KeyValueColl& co
 			_sqlLogsDir.append("/");
 	}
 
+	//how hard to try before going into degraded mode, and how often to check if it's back
+	_reconnectAttempts = 3;
+	_outageRetryInterval = 5000;
+	_down = false;
+	_outageStart = _lastProbe = 0;
+	_maxHeldOperations = 100000;
+	for (auto it=connParams.cbegin(); it!=connParams.cend(); ++it)
+	{
+		try
+		{
+			if (it->first == "reconnectattempts")
+			{
+				int attempts = boost::lexical_cast<int>(it->second);
+				_reconnectAttempts = (attempts > 1) ? attempts : 1;
+			}
+			else if (it->first == "outageretryinterval")
+			{
+				int interval = boost::lexical_cast<int>(it->second);
+				_outageRetryInterval = (interval > 100) ? interval : 100;
+			}
+			else if (it->first == "maxheldoperations")
+			{
+				int maxHeld = boost::lexical_cast<int>(it->second);
+				_maxHeldOperations = (maxHeld > 0) ? static_cast<size_t>(maxHeld) : 0;
+			}
+		}
+		catch (const boost::bad_lexical_cast&)
+		{
+			dbLogger.warning("Invalid value for " + it->first + ": " + it->second);
+		}
+	}
+
 	//create DB connections
 
 	//setup connection pool size
@@ -93,6 +129,8 @@ bool ConcreteDatabase::initialise(Poco::Logger& dbLogger, const KeyValueColl& co
 
 	_resultQueue.clear();
 
+	_maxStatementLen = queryMaxStatementLength();
+
 	initDelayThread();
 	return true;
 }
@@ -100,6 +138,8 @@ bool ConcreteDatabase::initialise(Poco::Logger& dbLogger, const KeyValueColl& co
 void ConcreteDatabase::stopServer()
 {
 	haltDelayThread();
+	//the delay thread has synced it on the way out
+	_journal.reset();
 
 	_resultQueue.clear();
 	_asyncConn.reset();
@@ -159,14 +199,73 @@ unique_ptr<QueryNamedResult> ConcreteDatabase::namedQuery( const char* sql )
 	return Retry::SqlOp< unique_ptr<QueryNamedResult> >(getLogger(),[sql](SqlConnection& c){ return c.namedQuery(sql); })(conn,"QueryNamed",[sql](){return sql;});
 }
 
+namespace
+{
+	//keeps the connection locked for as long as the streamed rows are being read
+	class LockedQueryResult : public QueryResult
+	{
+	public:
+		LockedQueryResult(SqlConnection& conn) : _guard(conn) {}
+		~LockedQueryResult() { _actualRes.reset(); }
+
+		void setResult(unique_ptr<QueryResult> res) { _actualRes = std::move(res); }
+		bool valid() const { return (_actualRes != nullptr); }
+
+		bool fetchRow() override { return _actualRes->fetchRow(); }
+		const vector<Field>& fields() const override { return _actualRes->fields(); }
+
+		size_t numFields() const override { return _actualRes->numFields(); }
+		UInt64 numRows() const override { return _actualRes->numRows(); }
+
+		QueryFieldNames fetchFieldNames() const override { return _actualRes->fetchFieldNames(); }
+		bool nextResult() override { return _actualRes->nextResult(); }
+		bool failed() const override { return _actualRes->failed(); }
+	private:
+		SqlConnection::Lock _guard;
+		unique_ptr<QueryResult> _actualRes;
+	};
+};
+
+unique_ptr<QueryResult> ConcreteDatabase::queryStreamed( const char* sql )
+{
+	return streamQuery(getQueryConnection(),sql);
+}
+
+unique_ptr<QueryResult> ConcreteDatabase::queryStreamedOn( size_t connIdx, const char* sql )
+{
+	poco_assert(connIdx < _queryConns.size());
+	return streamQuery(_queryConns[connIdx],sql);
+}
+
+unique_ptr<QueryResult> ConcreteDatabase::streamQuery( SqlConnection& conn, const char* sql )
+{
+	unique_ptr<LockedQueryResult> lockedRes(new LockedQueryResult(conn));
+	lockedRes->setResult(Retry::SqlOp< unique_ptr<QueryResult> >(getLogger(),[sql](SqlConnection& c){ return c.streamQuery(sql); })(conn,"QueryStreamed",[sql](){return sql;}));
+	if (!lockedRes->valid())
+		return nullptr;
+
+	return std::move(lockedRes);
+}
+
 bool ConcreteDatabase::directExecute( const char* sql )
 {
+	UInt64 affectedRows;
+	return directExecute(sql,affectedRows);
+}
+
+bool ConcreteDatabase::directExecute( const char* sql, UInt64& affectedRows )
+{
+	affectedRows = 0;
 	if(!_asyncConn)
 		return false;
 
 	SqlConnection& conn = getAsyncConnection();
 	SqlConnection::Lock guard(conn);
-	return Retry::SqlOp<bool>(getLogger(),[sql](SqlConnection& c){ return c.execute(sql); })(conn,"SqlExec",[sql](){return sql;} );
+	bool executed = Retry::SqlOp<bool>(getLogger(),[sql](SqlConnection& c){ return c.execute(sql); })(conn,"SqlExec",[sql](){return sql;} );
+	if (executed)
+		affectedRows = conn.affectedRows();
+
+	return executed;
 }
 
 void ConcreteDatabase::invokeCallbacks()
@@ -311,6 +410,23 @@ unique_ptr<QueryNamedResult> ConcreteDatabase::namedQueryParams(const char* form
 	return namedQuery(szQuery);
 }
 
+unique_ptr<QueryResult> ConcreteDatabase::queryStreamedParams(const char* format,...)
+{
+	if (!format)
+		return nullptr;
+
+	va_list ap;
+	char szQuery[MAX_QUERY_LEN];
+	va_start(ap, format);
+	int res = vsnprintf( szQuery, MAX_QUERY_LEN, format, ap );
+	va_end(ap);
+
+	if (!checkFmtError(res,format))
+		return nullptr;
+
+	return queryStreamed(szQuery);
+}
+
 bool ConcreteDatabase::execute(const char* sql)
 {
 	if (!_asyncConn)
@@ -321,20 +437,48 @@ bool ConcreteDatabase::execute(const char* sql)
 	{
 		//add SQL request to trans queue
 		pTrans->queueOperation(new SqlPlainRequest(sql));
+		if (_journal)
+			pTrans->addJournalSql(sql);
 	}
 	else //we are not in a transaction
 	{
 		//if async execution is not available
 		if(!_asyncAllowed)
 			return directExecute(sql);
+		if (!holdAllowed())
+			return false;
 
 		// Simple sql statement
-		_delayRunner->queueOperation(new SqlPlainRequest(sql));
+		if (_journal)
+		{
+			//queued in the same order as they're journalled, acknowledgements cover everything before them
+			SqlOperation* op = new SqlPlainRequest(sql);
+			Poco::FastMutex::ScopedLock guard(_journalLock);
+			op->setJournalled(_journal.get(),_journal->append(sql));
+			_delayRunner->queueOperation(op);
+		}
+		else
+			_delayRunner->queueOperation(new SqlPlainRequest(sql));
 	}
 
 	return true;
 }
 
+bool ConcreteDatabase::executeLowPriority(const char* sql)
+{
+	if (!_asyncConn)
+		return false;
+
+	//the journal (which transactions also go to) acknowledges in queue order, so those can't be overtaken
+	if (!_asyncAllowed || _journal || _transStorage->get())
+		return execute(sql);
+	if (!holdAllowed())
+		return false;
+
+	_delayRunner->queueLowPriority(new SqlPlainRequest(sql));
+	return true;
+}
+
 bool ConcreteDatabase::executeParams(const char* format,...)
 {
 	if (!format)
@@ -352,6 +496,57 @@ bool ConcreteDatabase::executeParams(const char* format,...)
 	return execute(szQuery);
 }
 
+namespace
+{
+	//room left for the UPDATE/SET/WHERE parts around the rows
+	const size_t BULK_STATEMENT_OVERHEAD = 4096;
+	//no point making a single statement bigger than this, even if the server takes it
+	const size_t MAX_BULK_STATEMENT_LEN = 4*1024*1024;
+
+	//rough number of characters a row adds to a bulk statement, whichever dialect
+	size_t BulkRowLength(const BulkUpdate& update, const BulkUpdate::Row& row)
+	{
+		size_t len = (row.key.length()+16) * (update.columns.size()+2);
+		for (auto it=row.values.cbegin(); it!=row.values.cend(); ++it)
+			len += it->length() + 4;
+
+		return len;
+	}
+};
+
+size_t ConcreteDatabase::executeBulkUpdate(const BulkUpdate& update)
+{
+	if (update.rows.empty())
+		return 0;
+
+	size_t maxLen = (_maxStatementLen < MAX_BULK_STATEMENT_LEN) ? _maxStatementLen : MAX_BULK_STATEMENT_LEN;
+	maxLen = (maxLen > BULK_STATEMENT_OVERHEAD*2) ? (maxLen - BULK_STATEMENT_OVERHEAD) : BULK_STATEMENT_OVERHEAD;
+
+	size_t numStatements = 0;
+	size_t firstRow = 0;
+	while (firstRow < update.rows.size())
+	{
+		//always at least one row per statement
+		size_t endRow = firstRow;
+		size_t stmtLen = 0;
+		do
+		{
+			stmtLen += BulkRowLength(update,update.rows[endRow]);
+			endRow++;
+		}
+		while (endRow < update.rows.size() && stmtLen + BulkRowLength(update,update.rows[endRow]) <= maxLen);
+
+		string sql = sqlBulkUpdate(update,firstRow,endRow);
+		if (!execute(sql.c_str()))
+			return 0;
+
+		numStatements++;
+		firstRow = endRow;
+	}
+
+	return numStatements;
+}
+
 bool ConcreteDatabase::directExecuteParams(const char* format,...)
 {
 	if (!format)
@@ -416,12 +611,34 @@ bool ConcreteDatabase::transactionCommit()
 	if(!_transStorage->get())
 		return false;
 
+	//nothing was written, no point queueing it
+	if (_transStorage->get()->empty())
+	{
+		_transStorage->reset();
+		return true;
+	}
+
 	//if async execution is not available
 	if(!_asyncAllowed)
 		return transactionCommitDirect();
 
+	if (!holdAllowed())
+	{
+		_transStorage->reset();
+		return false;
+	}
+
 	//add SqlTransaction to the async queue
-	_delayRunner->queueOperation(_transStorage->detach());
+	SqlTransaction* pTrans = _transStorage->detach();
+	if (_journal && !pTrans->journalSql().empty())
+	{
+		Poco::FastMutex::ScopedLock guard(_journalLock);
+		pTrans->setJournalled(_journal.get(),_journal->append(pTrans->journalSql()));
+		_delayRunner->queueOperation(pTrans);
+	}
+	else
+		_delayRunner->queueOperation(pTrans);
+
 	return true;
 }
 
@@ -460,9 +677,17 @@ bool ConcreteDatabase::executeStmt( const SqlStatementID& id, SqlStmtParameters&
 	if (!_asyncConn)
 		return false;
 
+	//the journal needs the sql right away
+	if (_journal)
+		params.resolveDeferred();
+
 	SqlTransaction* pTrans = _transStorage->get();
 	if(pTrans)
 	{
+		//the request takes the params, so render them first
+		if (_journal)
+			pTrans->addJournalSql(stmtToSql(id, params));
+
 		//add SQL request to trans queue
 		pTrans->queueOperation(new SqlPreparedRequest(id, params));
 	}
@@ -471,9 +696,22 @@ bool ConcreteDatabase::executeStmt( const SqlStatementID& id, SqlStmtParameters&
 		//if async execution is not available
 		if(!_asyncAllowed)
 			return directExecuteStmt(id, params);
+		if (!holdAllowed())
+			return false;
 
 		//Simple sql statement
-		_delayRunner->queueOperation(new SqlPreparedRequest(id, params));
+		if (_journal)
+		{
+			//the request takes the params, so render them first
+			std::string sql = stmtToSql(id, params);
+			SqlOperation* op = new SqlPreparedRequest(id, params);
+
+			Poco::FastMutex::ScopedLock guard(_journalLock);
+			op->setJournalled(_journal.get(),_journal->append(sql));
+			_delayRunner->queueOperation(op);
+		}
+		else
+			_delayRunner->queueOperation(new SqlPreparedRequest(id, params));
 	}
 
 	return true;
@@ -481,6 +719,8 @@ bool ConcreteDatabase::executeStmt( const SqlStatementID& id, SqlStmtParameters&
 
 bool ConcreteDatabase::directExecuteStmt( const SqlStatementID& id, SqlStmtParameters& params )
 {
+	params.resolveDeferred();
+
 	//execute statement
 	SqlConnection& conn = getAsyncConnection();
 	SqlConnection::Lock guard(conn);
@@ -576,3 +816,224 @@ const char* ConcreteDatabase::PreparedStmtRegistry::getStmtString( UInt32 stmtId
 
 	return nullptr;
 }
+
+#include <Poco/HexBinaryEncoder.h>
+
+std::string ConcreteDatabase::stmtToSql( const SqlStatementID& id, const SqlStmtParameters& params ) const
+{
+	std::string sql = getStmtString(id.getId());
+	size_t nLastPos = 0;
+
+	const SqlStmtParameters::ParameterContainer& holderArgs = params.params();
+	for (auto it=holderArgs.cbegin(); it!=holderArgs.cend(); ++it)
+	{
+		const SqlStmtField& data = (*it);
+
+		nLastPos = sql.find('?', nLastPos);
+		if (nLastPos == std::string::npos)
+			break;
+
+		std::ostringstream fmt;
+		//enough digits to get the same float/double back
+		fmt.precision(17);
+		switch (data.type())
+		{
+			case SqlStmtField::FIELD_BOOL:    fmt << "'" << UInt32(data.toBool()) << "'";     break;
+			case SqlStmtField::FIELD_UI8:     fmt << "'" << UInt32(data.toUint8()) << "'";    break;
+			case SqlStmtField::FIELD_UI16:    fmt << "'" << UInt32(data.toUint16()) << "'";   break;
+			case SqlStmtField::FIELD_UI32:    fmt << "'" << data.toUint32() << "'";           break;
+			case SqlStmtField::FIELD_UI64:    fmt << "'" << data.toUint64() << "'";           break;
+			case SqlStmtField::FIELD_I8:      fmt << "'" << Int32(data.toInt8()) << "'";      break;
+			case SqlStmtField::FIELD_I16:     fmt << "'" << Int32(data.toInt16()) << "'";     break;
+			case SqlStmtField::FIELD_I32:     fmt << "'" << data.toInt32() << "'";            break;
+			case SqlStmtField::FIELD_I64:     fmt << "'" << data.toInt64() << "'";            break;
+			case SqlStmtField::FIELD_FLOAT:   fmt << "'" << data.toFloat() << "'";            break;
+			case SqlStmtField::FIELD_DOUBLE:  fmt << "'" << data.toDouble() << "'";           break;
+			case SqlStmtField::FIELD_STRING:  fmt << "'" << escape(data.toString()) << "'";   break;
+			case SqlStmtField::FIELD_BINARY:
+			{
+				std::ostringstream ss;
+				Poco::HexBinaryEncoder(ss).write((const char*)data.buff(),data.size());
+				ss.flush();
+				fmt << "UNHEX('" << ss.str() << "')";
+			}
+			break;
+		}
+
+		std::string tmp = fmt.str();
+		sql.replace(nLastPos, 1, tmp);
+		nLastPos += tmp.length();
+	}
+
+	return sql;
+}
+
+bool ConcreteDatabase::openJournal( const std::string& fileName, UInt32 syncInterval )
+{
+	if (!_asyncConn || !_delayRunner)
+		return false;
+
+	unique_ptr<SqlJournal> journal(new SqlJournal(getLogger()));
+	SqlJournal::Entries unacked;
+	if (!journal->open(fileName, unacked))
+		return false;
+
+	//finish what the last run didn't get to, in the order it was queued
+	if (!unacked.empty())
+	{
+		size_t numFailed = 0;
+		SqlConnection& conn = getAsyncConnection();
+		auto replay = [&conn](const SqlJournal::Entry& entry) -> bool
+		{
+			if (entry.statements.size() == 1)
+				return SqlPlainRequest(entry.statements[0].c_str()).execute(conn);
+
+			SqlTransaction trans;
+			for (auto sqlIt=entry.statements.cbegin(); sqlIt!=entry.statements.cend(); ++sqlIt)
+				trans.queueOperation(new SqlPlainRequest(sqlIt->c_str()));
+
+			return trans.execute(conn);
+		};
+
+		for (auto it=unacked.begin(); it!=unacked.end(); ++it)
+		{
+			bool success = replay(*it);
+			for (int attempt=1; !success && inOutage() && attempt<JOURNAL_REPLAY_ATTEMPTS; attempt++)
+			{
+				Poco::Thread::sleep(_outageRetryInterval);
+				success = replay(*it);
+			}
+
+			//like at runtime, only the writes the database turned down are let go
+			if (!success && inOutage())
+			{
+				journal->sync();
+				size_t numLeft = static_cast<size_t>(unacked.end() - it);
+				_logger->critical(Poco::format("Database unreachable while replaying %s, %?u journalled writes are still in it and will be replayed on the next start",
+					fileName,numLeft));
+				return false;
+			}
+
+			if (!success)
+				numFailed++;
+
+			journal->acknowledge(it->seq);
+		}
+		journal->sync();
+
+		if (numFailed > 0)
+			_logger->warning(Poco::format("Replayed %?u journalled writes from %s, %?u failed",unacked.size(),fileName,numFailed));
+		else
+			_logger->information(Poco::format("Replayed %?u journalled writes from %s",unacked.size(),fileName));
+	}
+
+	_journal = std::move(journal);
+	_delayRunner->setJournal(_journal.get(), syncInterval);
+	return true;
+}
+
+UInt32 ConcreteDatabase::outageDuration() const
+{
+	Poco::FastMutex::ScopedLock guard(_outageLock);
+	if (!_down)
+		return 0;
+
+	UInt64 elapsed = GlobalTimer::getMSTime64() - _outageStart;
+	//0 means up, so a fresh outage still shows
+	if (elapsed < 1)
+		return 1;
+	if (elapsed > 0xFFFFFFFF)
+		return 0xFFFFFFFF;
+
+	return static_cast<UInt32>(elapsed);
+}
+
+size_t ConcreteDatabase::pendingOperations() const
+{
+	if (!_delayRunner)
+		return 0;
+
+	return _delayRunner->queueSize();
+}
+
+UInt32 ConcreteDatabase::droppedOperations() const
+{
+	if (!_delayRunner)
+		return 0;
+
+	return _delayRunner->droppedCount();
+}
+
+bool ConcreteDatabase::reconnectAllowed( size_t attempt )
+{
+	Poco::FastMutex::ScopedLock guard(_outageLock);
+	if (!_down)
+		return (attempt < _reconnectAttempts);
+
+	if (attempt > 0)
+		return false;
+
+	UInt64 now = GlobalTimer::getMSTime64();
+	if (now - _lastProbe < _outageRetryInterval)
+		return false;
+
+	_lastProbe = now;
+	return true;
+}
+
+bool ConcreteDatabase::available() const
+{
+	if (!_down)
+		return true;
+
+	Poco::FastMutex::ScopedLock guard(_outageLock);
+	return (GlobalTimer::getMSTime64() - _lastProbe >= _outageRetryInterval);
+}
+
+bool ConcreteDatabase::holdAllowed()
+{
+	if (!_down || _journal || _maxHeldOperations == 0 || pendingOperations() < _maxHeldOperations)
+		return true;
+
+	//the hashes of what was written have to know it didn't go out
+	_delayRunner->countDropped();
+	if (++_numRefused == 1)
+		_logger->error(Poco::format("%?u writes are held with no Journal to keep them, dropping new ones until the database is back",_maxHeldOperations));
+
+	return false;
+}
+
+void ConcreteDatabase::connectionLost()
+{
+	Poco::FastMutex::ScopedLock guard(_outageLock);
+	if (_down)
+		return;
+
+	_down = true;
+	_outageStart = _lastProbe = GlobalTimer::getMSTime64();
+	_numRefused = 0;
+	_logger->error(Poco::format("Database unreachable, failing queries and holding writes until it's back (checking every %u ms), %?u already waiting",_outageRetryInterval,pendingOperations()));
+	if (!_journal)
+	{
+		if (_maxHeldOperations > 0)
+			_logger->warning(Poco::format("No Journal is set, so held writes are only in memory and lost if the server goes down, at most %?u are kept",_maxHeldOperations));
+		else
+			_logger->warning("No Journal is set, so held writes are only in memory and lost if the server goes down, there's no limit to how many are kept");
+	}
+}
+
+void ConcreteDatabase::connectionRestored()
+{
+	if (!_down)
+		return;
+
+	Poco::FastMutex::ScopedLock guard(_outageLock);
+	if (!_down)
+		return;
+
+	_down = false;
+	UInt64 duration = GlobalTimer::getMSTime64() - _outageStart;
+	_logger->information(Poco::format("Database reachable again after %?u ms, %?u held operations will now run",duration,pendingOperations()));
+	if (_numRefused > 0)
+		_logger->error(Poco::format("%d writes were dropped during the outage, as too many were held",_numRefused.value()));
+}
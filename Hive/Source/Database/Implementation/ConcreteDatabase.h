@@ -30,6 +30,7 @@
 #include "Database/SqlStatement.h"
 #include "SqlDelayThread.h"
 #include "SqlOperations.h"
+#include "SqlJournal.h"
 
 class SqlParamBinder;
 
@@ -51,11 +52,20 @@ public:
 	unique_ptr<QueryResult> queryParams(const char* format,...) override;
 	unique_ptr<QueryNamedResult> namedQueryParams(const char* format,...) override;
 
+	unique_ptr<QueryResult> queryStreamed(const char* sql) override;
+	unique_ptr<QueryResult> queryStreamedParams(const char* format,...) override;
+	unique_ptr<QueryResult> queryStreamedOn(size_t connIdx, const char* sql) override;
+	size_t queryConnections() const override { return _queryConns.size(); }
+
 	bool directExecute(const char* sql) override;
+	bool directExecute(const char* sql, UInt64& affectedRows) override;
 	bool directExecuteParams(const char* format,...) override;
 
 	bool execute(const char* sql) override;
 	bool executeParams(const char* format,...) override;
+	bool executeLowPriority(const char* sql) override;
+
+	size_t executeBulkUpdate(const BulkUpdate& update) override;
 
 	bool asyncQuery(QueryCallback::FuncType func, const char* sql) override;
 	bool asyncQueryParams(QueryCallback::FuncType func, const char* format, ...) override;
@@ -66,6 +76,7 @@ public:
 	bool transactionCommit() override;
 	bool transactionRollback() override;
 	bool transactionCommitDirect() override;
+	bool transactionActive() const override { return (_transStorage->get() != nullptr); }
 
 	unique_ptr<SqlStatement> makeStatement(SqlStatementID& index, std::string sqlText) override;
 	const char* getStmtString(UInt32 stmtId) const;
@@ -81,6 +92,23 @@ public:
 
 	bool checkConnections() override;
 
+	bool openJournal(const std::string& fileName, UInt32 syncInterval) override;
+
+	UInt32 outageDuration() const override;
+	size_t pendingOperations() const override;
+	UInt32 droppedOperations() const override;
+
+	//reconnection policy shared by all the connections, attempt counts from 0
+	//once the database is down, just one attempt is made every _outageRetryInterval
+	bool reconnectAllowed(size_t attempt);
+	//false while down, except when it's time to try again
+	bool available() const;
+	bool inOutage() const { return _down; }
+	//false once too many writes are held in memory during an outage, the write is dropped then
+	bool holdAllowed();
+	void connectionLost();
+	void connectionRestored();
+
 	//Call this once you're out of global constructor code/DLLMain
 	void allowAsyncOperations() override { _asyncAllowed = true; }
 protected:
@@ -95,6 +123,8 @@ protected:
 	virtual unique_ptr<SqlConnection> createConnection(const KeyValueColl& connParams) = 0;
 	//factory method to create SqlDelayThread objects
 	virtual unique_ptr<SqlDelayThread> createDelayThread();
+	//longest statement the server accepts, asked once after connecting
+	virtual size_t queryMaxStatementLength() { return 1024*1024; }
 
 	class TransHelper
 	{
@@ -119,12 +149,14 @@ protected:
 
 	//per-thread based storage for SqlTransaction object initialization - no locking is required
 	typedef Poco::ThreadLocal<TransHelper> DBTransHelperTSS;
-	DBTransHelperTSS _transStorage;
+	mutable DBTransHelperTSS _transStorage;	//ThreadLocal has no const access
 
 	//DB connections
 
 	//round-robin connection selection
 	SqlConnection& getQueryConnection();
+	//streamed query that holds the connection until the result is destroyed
+	unique_ptr<QueryResult> streamQuery(SqlConnection& conn, const char* sql);
 	//for now return one single connection for async requests
 	SqlConnection& getAsyncConnection();
 
@@ -159,6 +191,11 @@ protected:
 			Poco::Thread::join();	//wait for thread to finish
 		}
 		bool queueOperation(SqlOperation* sql) { return _body->queueOperation(sql); }
+		bool queueLowPriority(SqlOperation* sql) { return _body->queueLowPriority(sql); }
+		void setJournal(SqlJournal* journal, UInt32 syncInterval) { _body->setJournal(journal,syncInterval); }
+		size_t queueSize() const { return _body->queueSize(); }
+		UInt32 droppedCount() const { return _body->droppedCount(); }
+		void countDropped() { _body->countDropped(); }
 	private:
 		unique_ptr<SqlDelayThread> _body;
 	};
@@ -167,6 +204,26 @@ protected:
 	//To prevent threading before they work properly
 	bool _asyncAllowed;
 
+	//async writes are recorded here before being queued, if opened
+	unique_ptr<SqlJournal> _journal;
+	Poco::FastMutex _journalLock;
+
+	//outage state
+	size_t _reconnectAttempts;
+	UInt32 _outageRetryInterval;
+	volatile bool _down;
+	UInt64 _outageStart;
+	UInt64 _lastProbe;
+	mutable Poco::FastMutex _outageLock;
+	//only without a journal, as that's all they'd be in (0 for no limit)
+	size_t _maxHeldOperations;
+	Poco::AtomicCounter _numRefused;
+	//plain sql of a prepared statement with its parameters filled in, for the journal
+	std::string stmtToSql(const SqlStatementID& id, const SqlStmtParameters& params) const;
+
+	//bulk updates are split to stay under this
+	size_t _maxStatementLen;
+
 	//PREPARED STATEMENT REGISTRY
 	class PreparedStmtRegistry
 	{
@@ -86,6 +86,46 @@ std::string DatabaseMySql::sqlOffset() const
 	return "LIMIT %d,1";
 }
 
+std::string DatabaseMySql::sqlBulkUpdate( const BulkUpdate& update, size_t firstRow, size_t endRow ) const
+{
+	//UPDATE t SET c = CASE k WHEN k1 THEN v1 ... ELSE c END, ... WHERE k IN (k1,...)
+	std::string sql = "UPDATE `" + update.tableName + "` SET ";
+	for (size_t col=0; col<update.columns.size(); col++)
+	{
+		const std::string& colName = update.columns[col];
+		if (col > 0)
+			sql += ", ";
+
+		sql += "`" + colName + "` = CASE `" + update.keyColumn + "`";
+		for (size_t i=firstRow; i<endRow; i++)
+			sql += " WHEN " + update.rows[i].key + " THEN " + update.rows[i].values[col];
+		sql += " ELSE `" + colName + "` END";
+	}
+
+	sql += " WHERE `" + update.keyColumn + "` IN (";
+	for (size_t i=firstRow; i<endRow; i++)
+	{
+		if (i > firstRow)
+			sql += ",";
+		sql += update.rows[i].key;
+	}
+	sql += ")";
+
+	for (auto it=update.filters.cbegin(); it!=update.filters.cend(); ++it)
+		sql += " AND `" + it->first + "` = " + it->second;
+
+	return sql;
+}
+
+size_t DatabaseMySql::queryMaxStatementLength()
+{
+	auto packetRes = query("SELECT @@max_allowed_packet");
+	if (packetRes && packetRes->fetchRow())
+		return static_cast<size_t>(packetRes->at(0).getUInt64());
+
+	return ConcreteDatabase::queryMaxStatementLength();
+}
+
 MySQLConnection::MySQLConnection( ConcreteDatabase& db, const Database::KeyValueColl& connParams ) 
 	: SqlConnection(db), _myConn(nullptr)
 {
@@ -231,11 +271,15 @@ void MySQLConnection::connect()
 			reconnecting = true;
 	}
 
+	//while the database is down, only try every now and then
+	if (reconnecting && !_dbEngine->reconnectAllowed(0))
+		throw SqlException(2006,"Database unreachable","reconnect",true);
+
 	//remove any state from previous session
 	this->clear();
 
 	Poco::Logger& logger = _dbEngine->getLogger();
-	for(;;)
+	for(size_t attempt=1;;attempt++)
 	{
 		const char* unix_socket = nullptr;
 		if (_unixSocket.length() > 0)
@@ -257,6 +301,13 @@ void MySQLConnection::connect()
 			if (IsConnectionErrFatal(errNo))
 				throw SqlException(errNo,mysql_error(_myHandle),actionToDo);
 
+			//don't hold up the caller forever, the database is considered down after a few tries
+			if (reconnecting && !_dbEngine->reconnectAllowed(attempt))
+			{
+				_dbEngine->connectionLost();
+				throw SqlException(errNo,mysql_error(_myHandle),actionToDo,true);
+			}
+
 			static const long sleepTime = 1000;
 			logger.warning(Poco::format("Could not %s to MySQL database at %s: %s, retrying in %d seconds",
 				string(actionToDo),_host,string(mysql_error(_myHandle)),static_cast<int>(sleepTime/1000)));
@@ -268,6 +319,8 @@ void MySQLConnection::connect()
 	}
 
 	string actionDone = (reconnecting)?string("Reconnected"):string("Connected");
+	if (reconnecting)
+		_dbEngine->connectionRestored();
 
 	poco_information(logger,Poco::format( actionDone + " to MySQL database %s:%d/%s client ver: %s server ver: %s",
 		_host, _port,_database,string(mysql_get_client_info()),string(mysql_get_server_info(_myConn)) ));
@@ -385,6 +438,50 @@ bool MySQLConnection::_MySQLStoreResult(const char* sql, ResultInfo* outResInfo)
 	}
 }
 
+void MySQLConnection::_MySQLUseResult(const char* sql, ResultInfo* outResInfo)
+{
+	MYSQL_RES* outResult = mysql_use_result(_myConn);
+	UInt64 outRowCount = 0;
+	size_t outFieldCount = 0;
+	if (outResult)
+		outFieldCount = mysql_num_fields(outResult);
+	else if (mysql_field_count(_myConn) == 0) //query doesnt return result set
+		outRowCount = mysql_affected_rows(_myConn);
+	else //an error occured (no results when there should be)
+	{
+		int resultRetVal = mysql_errno(_myConn);
+		if (resultRetVal)
+			throw SqlException(resultRetVal,mysql_error(_myConn),"MySQLUseResult",IsConnectionLost(resultRetVal),true,sql);
+	}
+
+	outResInfo->myRes = outResult;
+	outResInfo->numFields = outFieldCount;
+	outResInfo->numRows = outRowCount;
+}
+
+void MySQLConnection::_MySQLCheckFetch(const char* sql)
+{
+	//rows are read off the wire as they are fetched, so the end of rows can also mean a broken connection
+	int resultRetVal = mysql_errno(_myConn);
+	if (resultRetVal)
+		throw SqlException(resultRetVal,mysql_error(_myConn),"MySQLFetchRow",IsConnectionLost(resultRetVal),false,sql);
+}
+
+void MySQLConnection::_MySQLDiscardResults(const char* sql)
+{
+	int moreResults = mysql_next_result(_myConn);
+	if (moreResults == 0)
+	{
+		while (_MySQLStoreResult(sql)) {}
+	}
+	else if (moreResults > 0)
+	{
+		int resultRetVal = mysql_errno(_myConn);
+		if (resultRetVal)
+			throw SqlException(resultRetVal,mysql_error(_myConn),"MySQLNextResult",IsConnectionLost(resultRetVal),false,sql);
+	}
+}
+
 unique_ptr<QueryResult> MySQLConnection::query(const char* sql)
 {
 	if(!_Query(sql))
@@ -395,14 +492,34 @@ unique_ptr<QueryResult> MySQLConnection::query(const char* sql)
 	return queryResult;
 }
 
+unique_ptr<QueryResult> MySQLConnection::streamQuery(const char* sql)
+{
+	if(!_Query(sql))
+		return nullptr;
+
+	//only the result metadata is read in the constructor, rows come in with each fetchRow
+	unique_ptr<QueryResult> queryResult(new QueryResultMySqlStream(this,sql));
+	return queryResult;
+}
+
 bool MySQLConnection::execute(const char* sql)
 {
+	_affectedRows = 0;
 	bool qryRes = _Query(sql);
 	if (!qryRes)
 		return false;
 
-	//eat up results if any
-	while (_MySQLStoreResult(sql) == true) {}
+	//eat up results if any, counting the rows changed by the ones that aren't result sets
+	for (;;)
+	{
+		ResultInfo resInfo;
+		bool moreResults = _MySQLStoreResult(sql,&resInfo);
+		if (resInfo.myRes == nullptr)
+			_affectedRows += resInfo.numRows;
+
+		if (!moreResults)
+			break;
+	}
 
 	return true;
 }
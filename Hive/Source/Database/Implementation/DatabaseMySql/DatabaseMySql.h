@@ -83,6 +83,7 @@ public:
 	void connect() override;
 
 	unique_ptr<QueryResult> query(const char* sql) override;
+	unique_ptr<QueryResult> streamQuery(const char* sql) override;
 	bool execute(const char* sql);
 
 	size_t escapeString(char* to, const char* from, size_t length) const override;
@@ -127,6 +128,12 @@ public:
 	};
 	//Returns whether or not there are more results to be fetched (by again calling this method)
 	bool _MySQLStoreResult(const char* sql, ResultInfo* outResInfo = nullptr);
+	//Unbuffered version of the above, the rows have to be read (or the result freed) before calling _MySQLDiscardResults
+	void _MySQLUseResult(const char* sql, ResultInfo* outResInfo);
+	//Throws if the last row fetch of an unbuffered result failed
+	void _MySQLCheckFetch(const char* sql);
+	//Eats up any results that follow an unbuffered one
+	void _MySQLDiscardResults(const char* sql);
 
 	MYSQL_STMT* _MySQLStmtInit();
 	void _MySQLStmtPrepare(const SqlPreparedStatement& who, MYSQL_STMT* stmt, const char* sqlText, size_t textLen);
@@ -160,9 +167,11 @@ public:
 	std::string sqlTableSim(const std::string& tableName) const override;
 	std::string sqlConcat(const std::string& a, const std::string& b, const std::string& c) const override;
 	std::string sqlOffset() const override;
+	std::string sqlBulkUpdate(const BulkUpdate& update, size_t firstRow, size_t endRow) const override;
 
 protected:
 	unique_ptr<SqlConnection> createConnection(const KeyValueColl& connParams) override;
+	size_t queryMaxStatementLength() override;
 
 private:
 	static size_t db_count;
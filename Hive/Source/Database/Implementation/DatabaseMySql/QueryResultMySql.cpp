@@ -19,6 +19,8 @@
 #include "QueryResultMySql.h"
 #include "DatabaseMySql.h"
 
+#include <Poco/Logger.h>
+
 QueryResultMySql::QueryResultMySql(MySQLConnection* theConn, const char* sql) : _currRes(-1)
 {
 	bool hasAnotherResult = false;
@@ -147,5 +149,95 @@ QueryFieldNames QueryResultMySql::fetchFieldNames() const
 			fieldNames[i] = fields[i].name;
 	}
 
+	return std::move(fieldNames);
+}
+
+QueryResultMySqlStream::QueryResultMySqlStream(MySQLConnection* theConn, const char* sql) : _conn(theConn), _sql(sql), _finished(false), _failed(false)
+{
+	_conn->_MySQLUseResult(sql,&_result);
+
+	setNumFields(_result.numFields);
+	setNumRows(_result.numRows);
+
+	_row.resize(_result.numFields);
+	if (_row.size() > 0)
+	{
+		poco_assert(_result.myRes != nullptr);
+		MYSQL_FIELD* fields = mysql_fetch_fields(_result.myRes);
+		for (size_t i=0; i<_row.size(); i++)
+		{
+			_row[i].setValue(nullptr);
+			_row[i].setType(MySQLTypeToFieldType(fields[i].type));
+		}
+	}
+	else //nothing to stream, get the connection ready for the next query
+		finish();
+}
+
+QueryResultMySqlStream::~QueryResultMySqlStream() 
+{
+	finish();
+}
+
+void QueryResultMySqlStream::finish()
+{
+	if (_finished)
+		return;
+
+	_finished = true;
+	//this will also read any remaining rows off the wire
+	_result.clear();
+	try { _conn->_MySQLDiscardResults(_sql.c_str()); }
+	catch (const SqlConnection::SqlException& e) { e.toLog(_conn->getDB().getLogger()); }
+}
+
+bool QueryResultMySqlStream::fetchRow()
+{
+	if (_finished || _result.myRes == nullptr)
+		return false;
+
+	MYSQL_ROW myRow = mysql_fetch_row(_result.myRes);
+	if (!myRow) //no more rows, or the connection broke while reading them
+	{
+		try { _conn->_MySQLCheckFetch(_sql.c_str()); }
+		catch (const SqlConnection::SqlException& e) 
+		{ 
+			e.toLog(_conn->getDB().getLogger());
+			_failed = true;
+		}
+
+		finish();
+		return false;
+	}
+
+	//we got a row, point the pointers
+	for (size_t i=0; i<_row.size(); i++)
+		_row[i].setValue(myRow[i]);
+
+	setNumRows(numRows()+1);
+	return true;
+}
+
+bool QueryResultMySqlStream::nextResult()
+{
+	finish();
+
+	setNumFields(0);
+	setNumRows(0);
+	_row.clear();
+
+	return false;
+}
+
+QueryFieldNames QueryResultMySqlStream::fetchFieldNames() const
+{
+	if (_result.myRes == nullptr)
+		return QueryFieldNames();
+
+	QueryFieldNames fieldNames(_result.numFields);
+	MYSQL_FIELD* fields = mysql_fetch_fields(_result.myRes);
+	for (size_t i=0; i<fieldNames.size(); i++)
+		fieldNames[i] = fields[i].name;
+
 	return std::move(fieldNames);
 }
\ No newline at end of file
@@ -35,4 +35,28 @@ public:
 private:
 	vector<MySQLConnection::ResultInfo> _results;
 	int _currRes;
+};
+
+//Unbuffered result, rows aren't stored client side but read from the server as they are fetched
+//Only the first result set is accessible, any others are discarded
+class QueryResultMySqlStream : public QueryResultImpl
+{
+public:
+	QueryResultMySqlStream(MySQLConnection* theConn, const char* sql);
+	~QueryResultMySqlStream();
+
+	bool fetchRow() override;
+	QueryFieldNames fetchFieldNames() const override;
+
+	bool nextResult() override;
+	bool failed() const override { return _failed; }
+private:
+	//frees the result and eats up whatever the server has left for us
+	void finish();
+
+	MySQLConnection* _conn;
+	std::string _sql;
+	MySQLConnection::ResultInfo _result;
+	bool _finished;
+	bool _failed;
 };
\ No newline at end of file
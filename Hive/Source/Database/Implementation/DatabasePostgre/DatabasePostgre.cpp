@@ -66,6 +66,41 @@ std::string DatabasePostgre::sqlOffset() const
 	return "LIMIT 1 OFFSET %d";
 }
 
+std::string DatabasePostgre::sqlBulkUpdate( const BulkUpdate& update, size_t firstRow, size_t endRow ) const
+{
+	//UPDATE t SET c = v.c, ... FROM (VALUES (k1,v1,...),...) AS v(k,c,...) WHERE t.k = v.k
+	std::string sql = "UPDATE \"" + update.tableName + "\" SET ";
+	for (size_t col=0; col<update.columns.size(); col++)
+	{
+		if (col > 0)
+			sql += ", ";
+		sql += "\"" + update.columns[col] + "\" = \"bulk_v\".\"" + update.columns[col] + "\"";
+	}
+
+	sql += " FROM (VALUES ";
+	for (size_t i=firstRow; i<endRow; i++)
+	{
+		const BulkUpdate::Row& row = update.rows[i];
+		if (i > firstRow)
+			sql += ",";
+
+		sql += "(" + row.key;
+		for (auto it=row.values.cbegin(); it!=row.values.cend(); ++it)
+			sql += "," + *it;
+		sql += ")";
+	}
+	sql += ") AS \"bulk_v\"(\"" + update.keyColumn + "\"";
+	for (auto it=update.columns.cbegin(); it!=update.columns.cend(); ++it)
+		sql += ",\"" + *it + "\"";
+	sql += ")";
+
+	sql += " WHERE \"" + update.tableName + "\".\"" + update.keyColumn + "\" = \"bulk_v\".\"" + update.keyColumn + "\"";
+	for (auto it=update.filters.cbegin(); it!=update.filters.cend(); ++it)
+		sql += " AND \"" + update.tableName + "\".\"" + it->first + "\" = " + it->second;
+
+	return sql;
+}
+
 PostgreSQLConnection::PostgreSQLConnection(ConcreteDatabase& parent, const Database::KeyValueColl& connParams) 
 	: SqlConnection(parent), _pgConn(nullptr) 
 {
@@ -112,11 +147,15 @@ void PostgreSQLConnection::connect()
 			reconnecting = true;
 	}
 
+	//while the database is down, only try every now and then
+	if (reconnecting && !_dbEngine->reconnectAllowed(0))
+		throw SqlException(0,"Database unreachable","reconnect",true);
+
 	//remove any state from previous session
 	this->clear();
 
 	Poco::Logger& logger = _dbEngine->getLogger();
-	for(;;)
+	for(size_t attempt=1;;attempt++)
 	{
 		if (reconnecting)
 			PQreset(_pgConn);
@@ -135,6 +174,13 @@ void PostgreSQLConnection::connect()
 			if (reconnecting)
 				actionToDo = "reconnect";
 
+			//don't hold up the caller forever, the database is considered down after a few tries
+			if (reconnecting && !_dbEngine->reconnectAllowed(attempt))
+			{
+				_dbEngine->connectionLost();
+				throw SqlException(0,lastErrorDescr(),actionToDo,true);
+			}
+
 			static const long sleepTime = 1000;
 			logger.warning(Poco::format("Could not %s to Postgre database at %s: %s, retrying in %d seconds",
 				string(actionToDo),_host,lastErrorDescr(),static_cast<int>(sleepTime/1000)));
@@ -146,6 +192,8 @@ void PostgreSQLConnection::connect()
 	}
 
 	string actionDone = (reconnecting)?string("Reconnected"):string("Connected");
+	if (reconnecting)
+		_dbEngine->connectionRestored();
 	poco_information(logger,Poco::format("%s to Postgre database %s:%s/%s server ver: %d",actionDone,_host,_port,_database,PQserverVersion(_pgConn)));
 }
 
@@ -194,7 +242,7 @@ bool PostgreSQLConnection::_PostgreStoreResult( const char* sql, ResultInfo* out
 	ExecStatusType resStatus = PQresultStatus(outResult);
 	int outRowCount = 0;
 	int outFieldCount = 0;
-	if (resStatus == PGRES_TUPLES_OK) //has resultset
+	if (resStatus == PGRES_TUPLES_OK || resStatus == PGRES_SINGLE_TUPLE) //has resultset
 	{
 		outRowCount = PQntuples(outResult);
 		outFieldCount = PQnfields(outResult);
@@ -243,21 +291,38 @@ unique_ptr<QueryResult> PostgreSQLConnection::query(const char* sql)
 	return queryResult;
 }
 
+unique_ptr<QueryResult> PostgreSQLConnection::streamQuery(const char* sql)
+{
+	if(!_Query(sql))
+		return nullptr;
+
+	//if this fails, we just get the whole result in one piece, which the stream can handle as well
+	PQsetSingleRowMode(_pgConn);
+
+	unique_ptr<QueryResult> queryResult(new QueryResultPostgreStream(this,sql));
+	return queryResult;
+}
+
 bool PostgreSQLConnection::execute(const char* sql)
 {
+	_affectedRows = 0;
 	bool qryRes = _Query(sql);
 	if (!qryRes)
 		return false;
 
-	//eat up results if any
+	//eat up results if any, counting the rows changed by the ones that aren't result sets
 	vector<SqlException> excs;
 	for (;;)
 	{
 		//can't skip result fetch, even on error, untill all are eaten
 		try
 		{
-			if (_PostgreStoreResult(sql) == false)
+			ResultInfo resInfo;
+			if (_PostgreStoreResult(sql,&resInfo) == false)
 				break;
+
+			if (resInfo.pgRes == nullptr)
+				_affectedRows += resInfo.numRows;
 		}
 		catch (const SqlException& e) {	excs.push_back(e);	}
 	}
@@ -36,6 +36,7 @@ public:
 	void connect() override;
 
 	unique_ptr<QueryResult> query(const char* sql) override;
+	unique_ptr<QueryResult> streamQuery(const char* sql) override;
 	bool execute(const char* sql) override;
 
 	size_t escapeString(char* to, const char* from, size_t length) const override;
@@ -100,6 +101,7 @@ public:
 	std::string sqlTableSim(const std::string& tableName) const override;
 	std::string sqlConcat(const std::string& a, const std::string& b, const std::string& c) const override;
 	std::string sqlOffset() const override;
+	std::string sqlBulkUpdate(const BulkUpdate& update, size_t firstRow, size_t endRow) const override;
 protected:
 	unique_ptr<SqlConnection> createConnection(const KeyValueColl& connParams) override;
 private:
@@ -18,6 +18,8 @@
 
 #include "QueryResultPostgre.h"
 
+#include <Poco/Logger.h>
+
 namespace
 {
 	//From pg_type.h in postgresql server includes.
@@ -240,3 +242,121 @@ QueryFieldNames QueryResultPostgre::fetchFieldNames() const
 	return std::move(fieldNames);
 }
 
+QueryResultPostgreStream::QueryResultPostgreStream(PostgreSQLConnection* theConn, const char* sql) : _conn(theConn), _sql(sql), _tblIdx(0), _finished(false), _failed(false)
+{
+	bool gotResult = false;
+	try { gotResult = _conn->_PostgreStoreResult(sql,&_current); }
+	catch (const SqlConnection::SqlException&)
+	{
+		//can't leave the other results lying around on the connection
+		finish();
+		throw;
+	}
+
+	setNumFields(_current.numFields);
+	setNumRows(0);
+
+	_row.resize(_current.numFields);
+	_fieldNames.resize(_current.numFields);
+	if (_row.size() > 0)
+	{
+		poco_assert(_current.pgRes != nullptr);
+		for (size_t i=0; i<_row.size(); i++)
+		{
+			_row[i].setValue(nullptr);
+			_row[i].setType(PostgreTypeToFieldType(PQftype(_current.pgRes,static_cast<int>(i))));
+			_fieldNames[i] = PQfname(_current.pgRes,static_cast<int>(i));
+		}
+	}
+	else //not a SELECT, so there's nothing to stream
+	{
+		if (gotResult)
+			setNumRows(_current.numRows);
+
+		finish();
+	}
+}
+
+QueryResultPostgreStream::~QueryResultPostgreStream() 
+{
+	finish();
+}
+
+void QueryResultPostgreStream::finish()
+{
+	if (_finished)
+		return;
+
+	_finished = true;
+	_current.clear();
+	for (;;)
+	{
+		//can't skip result fetch, even on error, untill all are eaten
+		try
+		{
+			if (_conn->_PostgreStoreResult(_sql.c_str()) == false)
+				break;
+		}
+		catch (const SqlConnection::SqlException& e) { e.toLog(_conn->getDB().getLogger()); }
+	}
+}
+
+bool QueryResultPostgreStream::fetchRow()
+{
+	if (_finished)
+		return false;
+
+	//exhausted the rows we've got so far, get the next one
+	if (_tblIdx >= static_cast<size_t>(_current.numRows))
+	{
+		_current.clear();
+		_tblIdx = 0;
+
+		bool gotResult = false;
+		try { gotResult = _conn->_PostgreStoreResult(_sql.c_str(),&_current); }
+		catch (const SqlConnection::SqlException& e) 
+		{ 
+			e.toLog(_conn->getDB().getLogger());
+			_failed = true;
+		}
+
+		//the final result of a single-row mode query has no rows
+		if (!gotResult || _current.pgRes == nullptr || _current.numRows < 1)
+		{
+			finish();
+			return false;
+		}
+	}
+
+	for (size_t fieldNum=0; fieldNum<_row.size(); fieldNum++)
+	{
+		const char* strValue = PQgetvalue(_current.pgRes,static_cast<int>(_tblIdx),static_cast<int>(fieldNum));
+		poco_assert(strValue != nullptr); //postgres always returns a valid cstr pointer
+		if (PQgetisnull(_current.pgRes,static_cast<int>(_tblIdx),static_cast<int>(fieldNum)))
+			strValue = nullptr; //nullify if the actual field is NULL
+
+		_row[fieldNum].setValue(strValue);
+	}
+	_tblIdx++;
+
+	setNumRows(numRows()+1);
+	return true;
+}
+
+bool QueryResultPostgreStream::nextResult()
+{
+	finish();
+
+	setNumFields(0);
+	setNumRows(0);
+	_row.clear();
+	_fieldNames.clear();
+
+	return false;
+}
+
+QueryFieldNames QueryResultPostgreStream::fetchFieldNames() const 
+{
+	return _fieldNames;
+}
+
@@ -36,3 +36,29 @@ private:
 	int _currRes;
 	size_t _tblIdx;
 };
+
+//Rows are received one by one in single-row mode, instead of the whole result being buffered
+//Only the first result set is accessible, any others are discarded
+class QueryResultPostgreStream : public QueryResultImpl
+{
+public:
+	QueryResultPostgreStream(PostgreSQLConnection* theConn, const char* sql);
+	~QueryResultPostgreStream();
+
+	bool fetchRow() override;
+	QueryFieldNames fetchFieldNames() const override;
+
+	bool nextResult() override;
+	bool failed() const override { return _failed; }
+private:
+	//eats up whatever the server has left for us
+	void finish();
+
+	PostgreSQLConnection* _conn;
+	std::string _sql;
+	PostgreSQLConnection::ResultInfo _current;
+	QueryFieldNames _fieldNames;
+	size_t _tblIdx;
+	bool _finished;
+	bool _failed;
+};
@@ -19,12 +19,16 @@
 #pragma once
 
 #include "SqlConnection.h"
+#include "ConcreteDatabase.h"
 #include "Shared/Common/Timer.h"
 #include <boost/function.hpp>
 #include <Poco/Format.h>
 
 namespace Retry
 {
+	//repeatable errors (deadlocks and such) are given this many goes
+	static const size_t MAX_TRIES = 10;
+
 	template<typename RetVal>
 	struct SqlOp
 	{
@@ -34,7 +38,16 @@ namespace Retry
 		SqlOp(Poco::Logger& log_, FuncType runMe_, bool throwExc_ = false) : runMe(runMe_), loggerInst(log_), throwExc(throwExc_) {}
 		RetVal operator () (SqlConnection& theConn,const char* logStr="",SqlStrType sqlLogFunc = [](){ return ""; })
 		{
-			for (;;)
+			//fail right away while the database is down, instead of stalling the caller
+			if (!theConn.getDB().available())
+			{
+				if (throwExc)
+					throw SqlConnection::SqlException(0,"Database unreachable",logStr,true);
+				else
+					return 0;
+			}
+
+			for (size_t tries=1;;tries++)
 			{
 				try 
 				{ 
@@ -42,6 +55,8 @@ namespace Retry
 					if (loggerInst.trace())
 						startTime = GlobalTimer::getMSTime();
 					RetVal returnMe = runMe(theConn); 
+					//got through, so it's back if it was down
+					theConn.getDB().connectionRestored();
 					if (loggerInst.trace())
 					{
 						std::string sqlStr = sqlLogFunc();
@@ -77,7 +92,7 @@ namespace Retry
 					}
 					if (throwExc)
 						throw opExc;
-					else if (opExc.isRepeatable())
+					else if (opExc.isRepeatable() && tries < MAX_TRIES)
 						continue;
 					else
 						return 0;
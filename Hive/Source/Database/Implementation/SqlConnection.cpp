@@ -126,6 +126,11 @@ unique_ptr<QueryNamedResult> SqlConnection::namedQuery( const char* sql )
 	return unique_ptr<QueryNamedResult>(new QueryNamedResult(std::move(realRes)));
 }
 
+unique_ptr<QueryResult> SqlConnection::streamQuery( const char* sql )
+{
+	return this->query(sql);
+}
+
 size_t SqlConnection::escapeString( char* to, const char* from, size_t length ) const
 {
 	strncpy(to,from,length); 
@@ -68,9 +68,13 @@ public:
 	//public methods for making queries
 	virtual unique_ptr<QueryResult> query(const char* sql) = 0;
 	virtual unique_ptr<QueryNamedResult> namedQuery(const char* sql);
+	//unbuffered variant, defaults to a regular query if the DB doesn't support it
+	virtual unique_ptr<QueryResult> streamQuery(const char* sql);
 
 	//public methods for making requests
 	virtual bool execute(const char* sql) = 0;
+	//rows changed by the last execute on this connection
+	UInt64 affectedRows() const { return _affectedRows; }
 
 	//escape string generation
 	virtual size_t escapeString(char* to, const char* from, size_t length) const;
@@ -100,8 +104,9 @@ public:
 	//allocate and return prepared statement object
 	SqlPreparedStatement* getStmt(const SqlStatementID& stId);
 protected:
-	SqlConnection(ConcreteDatabase& db) : _dbEngine(&db) {}
+	SqlConnection(ConcreteDatabase& db) : _dbEngine(&db), _affectedRows(0) {}
 	ConcreteDatabase* _dbEngine;
+	UInt64 _affectedRows;
 
 	//make connection-specific prepared statement obj
 	virtual SqlPreparedStatement* createPreparedStatement(const char* sqlText);
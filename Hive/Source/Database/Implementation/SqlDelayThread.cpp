@@ -19,10 +19,12 @@
 #include "SqlDelayThread.h"
 #include "Database/Database.h"
 #include "SqlOperations.h"
+#include "SqlJournal.h"
+#include "Shared/Common/Timer.h"
 
 #include <Poco/Thread.h>
 
-SqlDelayThread::SqlDelayThread(Database& db, SqlConnection& conn) : _dbEngine(db), _dbConn(conn), _isRunning(true)
+SqlDelayThread::SqlDelayThread(Database& db, SqlConnection& conn) : _dbEngine(db), _dbConn(conn), _isRunning(true), _journal(nullptr), _journalSyncInterval(0), _stalled(nullptr)
 {
 }
 
@@ -32,6 +34,18 @@ SqlDelayThread::~SqlDelayThread()
 	stop();
     //process all requests which might have been queued while thread was stopping
     processRequests();
+
+	//whatever is left couldn't reach the database, the journal (if any) still has it
+	if (_stalled)
+	{
+		_stalled->onRemove();
+		_stalled = nullptr;
+	}
+	SqlOperation* s = nullptr;
+	while (_sqlQueue.try_pop(s))
+		s->onRemove();
+	while (_lowQueue.try_pop(s))
+		s->onRemove();
 }
 
 void SqlDelayThread::run()
@@ -39,6 +53,7 @@ void SqlDelayThread::run()
 	_dbEngine.threadEnter();
 
     const size_t loopSleepMS = 10;
+	UInt32 lastJournalSync = GlobalTimer::getMSTime();
 
     while (_isRunning)
     {
@@ -47,8 +62,18 @@ void SqlDelayThread::run()
         Poco::Thread::sleep(loopSleepMS);
 
         processRequests();
+
+		//one flush to disk for everything written since the last one
+		if (_journal && GlobalTimer::getMSTimeDiff(lastJournalSync,GlobalTimer::getMSTime()) >= _journalSyncInterval)
+		{
+			_journal->sync();
+			lastJournalSync = GlobalTimer::getMSTime();
+		}
     }
 
+	if (_journal)
+		_journal->sync();
+
 	_dbEngine.threadExit();
 }
 
@@ -59,10 +84,50 @@ void SqlDelayThread::stop()
 
 void SqlDelayThread::processRequests()
 {
+	//held back until the database is reachable, so everything still runs in order
+	if (_stalled)
+	{
+		if (!_stalled->execute(_dbConn))
+		{
+			if (_dbEngine.outageDuration() > 0)
+				return;
+
+			++_numDropped;
+		}
+		_stalled->onRemove();
+		_stalled = nullptr;
+		--_numQueued;
+	}
+
     SqlOperation* s = nullptr;
     while (_sqlQueue.try_pop(s))
     {
-        s->execute(_dbConn);
+        if (!s->execute(_dbConn))
+		{
+			if (_dbEngine.outageDuration() > 0)
+			{
+				_stalled = s;
+				return;
+			}
+			++_numDropped;
+		}
         s->onRemove();
+		--_numQueued;
     }
+
+	//one at a time, so anything queued meanwhile goes first
+	while (_sqlQueue.empty() && _lowQueue.try_pop(s))
+	{
+		if (!s->execute(_dbConn))
+		{
+			if (_dbEngine.outageDuration() > 0)
+			{
+				_stalled = s;
+				return;
+			}
+			++_numDropped;
+		}
+		s->onRemove();
+		--_numQueued;
+	}
 }
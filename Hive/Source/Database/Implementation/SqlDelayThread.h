@@ -18,12 +18,16 @@
 
 #pragma once
 
+#include "Shared/Common/Types.h"
+
 #include <tbb/concurrent_queue.h>
 #include <Poco/Runnable.h>
+#include <Poco/AtomicCounter.h>
 
 class Database;
 class SqlOperation;
 class SqlConnection;
+class SqlJournal;
 
 class SqlDelayThread : public Poco::Runnable
 {
@@ -31,10 +35,18 @@ protected:
 	typedef tbb::concurrent_queue<SqlOperation*> SqlQueue;
 
 	SqlQueue _sqlQueue;			//Queue of SQL statements
+	SqlQueue _lowQueue;			//only run when _sqlQueue is empty
 	Database& _dbEngine;		//Pointer to used Database engine
 	SqlConnection& _dbConn;		//Pointer to DB connection
 	volatile bool _isRunning;
 
+	SqlJournal* volatile _journal;	//synced every _journalSyncInterval ms, if set
+	UInt32 _journalSyncInterval;
+
+	Poco::AtomicCounter _numQueued;
+	Poco::AtomicCounter _numDropped;	//failed while the database was up, so they won't be run again
+	SqlOperation* _stalled;		//failed while the database was down, runs again before anything else
+
 	//process all enqueued requests
 	virtual void processRequests();
 public:
@@ -44,9 +56,27 @@ public:
 	//Put sql statement to delay queue
 	bool queueOperation(SqlOperation* sql) 
 	{
+		++_numQueued;
 		_sqlQueue.push(sql);
 		return true; 
 	}
+	bool queueLowPriority(SqlOperation* sql)
+	{
+		++_numQueued;
+		_lowQueue.push(sql);
+		return true;
+	}
+	//operations not yet run (including a stalled one)
+	size_t queueSize() const { return static_cast<size_t>(_numQueued.value()); }
+	UInt32 droppedCount() const { return static_cast<UInt32>(_numDropped.value()); }
+	//for writes refused before they got queued
+	void countDropped() { ++_numDropped; }
+
+	void setJournal(SqlJournal* journal, UInt32 syncInterval)
+	{
+		_journalSyncInterval = syncInterval;
+		_journal = journal;
+	}
 
 	//Send stop event
 	virtual void stop();
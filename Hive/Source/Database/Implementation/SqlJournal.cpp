@@ -0,0 +1,303 @@
+/*
+* Copyright (C) 2009-2012 Rajko Stojadinovic <http://github.com/rajkosto/hive>
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*/
+
+#include "SqlJournal.h"
+
+#include <Poco/Logger.h>
+#include <Poco/Checksum.h>
+#include <boost/lexical_cast.hpp>
+#include <cstring>
+
+#ifdef WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+using boost::lexical_cast;
+
+//record layout, native byte order:
+//UInt8 type, UInt64 seq, UInt32 payload length, payload, UInt32 crc32 of all of the above
+//statements payload is UInt32 count, then for each UInt32 length followed by the sql
+namespace
+{
+	const size_t RECORD_HEADER_SIZE = sizeof(UInt8)+sizeof(UInt64)+sizeof(UInt32);
+	//well past the longest statement the database takes, anything longer is a damaged header
+	const UInt32 MAX_PAYLOAD_LEN = 64*1024*1024;
+
+	template<typename T>
+	void PutRaw(std::string& out, T val) { out.append(reinterpret_cast<const char*>(&val),sizeof(val)); }
+
+	template<typename T>
+	bool GetRaw(const std::string& in, size_t& pos, T& outVal)
+	{
+		if (pos + sizeof(outVal) > in.length())
+			return false;
+
+		std::memcpy(&outVal,in.data()+pos,sizeof(outVal));
+		pos += sizeof(outVal);
+		return true;
+	}
+
+	bool ReadExactly(FILE* file, std::string& out, size_t len)
+	{
+		out.resize(len);
+		if (len == 0)
+			return true;
+
+		return (fread(&out[0],1,len,file) == len);
+	}
+
+	UInt32 RecordChecksum(const std::string& header, const std::string& payload)
+	{
+		Poco::Checksum crc(Poco::Checksum::TYPE_CRC32);
+		crc.update(header.data(),header.length());
+		if (!payload.empty())
+			crc.update(payload.data(),payload.length());
+
+		return crc.checksum();
+	}
+
+	std::string EncodeStatements(const std::vector<std::string>& statements)
+	{
+		std::string payload;
+		PutRaw(payload,static_cast<UInt32>(statements.size()));
+		for (auto it=statements.cbegin(); it!=statements.cend(); ++it)
+		{
+			PutRaw(payload,static_cast<UInt32>(it->length()));
+			payload += *it;
+		}
+		return payload;
+	}
+};
+
+SqlJournal::SqlJournal(Poco::Logger& logger) : _logger(logger), _file(nullptr), _lastSeq(0), _ackedSeq(0), _writtenAckSeq(0), _unsynced(false)
+{
+}
+
+SqlJournal::~SqlJournal()
+{
+	close();
+}
+
+bool SqlJournal::open(const std::string& fileName, Entries& outUnacked)
+{
+	close();
+
+	GuardType guard(_lock);
+	_fileName = fileName;
+	outUnacked.clear();
+
+	UInt64 ackedSeq = 0;
+	Entries written;
+	if (FILE* oldFile = fopen(_fileName.c_str(),"rb"))
+	{
+		std::string header, payload, crcBuf;
+		for (;;)
+		{
+			if (!ReadExactly(oldFile,header,RECORD_HEADER_SIZE))
+				break;
+
+			size_t pos = 0;
+			UInt8 type;
+			UInt64 seq;
+			UInt32 payloadLen;
+			GetRaw(header,pos,type);
+			GetRaw(header,pos,seq);
+			GetRaw(header,pos,payloadLen);
+			if (payloadLen > MAX_PAYLOAD_LEN)
+			{
+				_logger.warning("Journal " + _fileName + " has a damaged record after sequence " + lexical_cast<std::string>(seq) + ", ignoring the rest");
+				break;
+			}
+
+			UInt32 crc;
+			pos = 0;
+			if (!ReadExactly(oldFile,payload,payloadLen) || !ReadExactly(oldFile,crcBuf,sizeof(crc)) || !GetRaw(crcBuf,pos,crc))
+				break;
+
+			//a torn write at the end, from when the process died
+			if (crc != RecordChecksum(header,payload))
+			{
+				_logger.warning("Journal " + _fileName + " has a damaged record after sequence " + lexical_cast<std::string>(seq) + ", ignoring the rest");
+				break;
+			}
+
+			if (type == RECORD_ACK)
+			{
+				if (seq > ackedSeq)
+					ackedSeq = seq;
+			}
+			else if (type == RECORD_STATEMENTS)
+			{
+				Entry entry;
+				entry.seq = seq;
+
+				pos = 0;
+				UInt32 numStatements = 0;
+				GetRaw(payload,pos,numStatements);
+				for (UInt32 i=0; i<numStatements; i++)
+				{
+					UInt32 sqlLen = 0;
+					if (!GetRaw(payload,pos,sqlLen) || pos + sqlLen > payload.length())
+						break;
+
+					entry.statements.push_back(payload.substr(pos,sqlLen));
+					pos += sqlLen;
+				}
+				written.push_back(std::move(entry));
+			}
+		}
+		fclose(oldFile);
+	}
+
+	//start afresh, with just the leftovers carried over (renumbered)
+	_file = fopen(_fileName.c_str(),"wb");
+	if (!_file)
+	{
+		_logger.error("Unable to open journal " + _fileName);
+		return false;
+	}
+
+	_lastSeq = _ackedSeq = _writtenAckSeq = 0;
+	_unsynced = false;
+
+	for (auto it=written.begin(); it!=written.end(); ++it)
+	{
+		if (it->seq <= ackedSeq)
+			continue;
+
+		it->seq = ++_lastSeq;
+		if (!writeRecord(RECORD_STATEMENTS,it->seq,EncodeStatements(it->statements)))
+		{
+			_logger.error("Failed writing to journal " + _fileName);
+			return false;
+		}
+		outUnacked.push_back(std::move(*it));
+	}
+
+	return true;
+}
+
+void SqlJournal::close()
+{
+	sync();
+
+	GuardType guard(_lock);
+	if (_file)
+	{
+		fclose(_file);
+		_file = nullptr;
+	}
+}
+
+bool SqlJournal::writeRecord(UInt8 type, UInt64 seq, const std::string& payload)
+{
+	std::string header;
+	PutRaw(header,type);
+	PutRaw(header,seq);
+	PutRaw(header,static_cast<UInt32>(payload.length()));
+
+	std::string record = header + payload;
+	PutRaw(record,RecordChecksum(header,payload));
+
+	if (fwrite(record.data(),1,record.length(),_file) != record.length())
+		return false;
+
+	//into the OS right away, so it survives the process dying
+	//making it survive the machine dying is left to sync()
+	fflush(_file);
+	_unsynced = true;
+	return true;
+}
+
+UInt64 SqlJournal::append(const std::vector<std::string>& statements)
+{
+	GuardType guard(_lock);
+	if (!_file)
+		return 0;
+
+	UInt64 seq = _lastSeq + 1;
+	if (!writeRecord(RECORD_STATEMENTS,seq,EncodeStatements(statements)))
+	{
+		_logger.error("Failed writing to journal " + _fileName);
+		return 0;
+	}
+
+	_lastSeq = seq;
+	return seq;
+}
+
+UInt64 SqlJournal::append(const std::string& sql)
+{
+	return append(std::vector<std::string>(1,sql));
+}
+
+void SqlJournal::acknowledge(UInt64 seq)
+{
+	GuardType guard(_lock);
+	if (seq <= _ackedSeq)
+		return;
+
+	//in the file before the next write runs, so a restart can't run one again that already went through
+	_ackedSeq = seq;
+	if (_file && writeRecord(RECORD_ACK,_ackedSeq,std::string()))
+		_writtenAckSeq = _ackedSeq;
+}
+
+UInt64 SqlJournal::pending() const
+{
+	GuardType guard(_lock);
+	return _lastSeq - _ackedSeq;
+}
+
+void SqlJournal::sync()
+{
+	GuardType guard(_lock);
+	if (!_file)
+		return;
+
+	//all caught up, no need to keep any of it
+	if (_ackedSeq == _lastSeq && (_lastSeq > 0 || _unsynced))
+	{
+		fclose(_file);
+		_file = fopen(_fileName.c_str(),"wb");
+		if (!_file)
+			_logger.error("Unable to reopen journal " + _fileName + ", async writes are no longer journaled");
+
+		_lastSeq = _ackedSeq = _writtenAckSeq = 0;
+		_unsynced = false;
+		return;
+	}
+
+	if (_ackedSeq > _writtenAckSeq)
+	{
+		if (writeRecord(RECORD_ACK,_ackedSeq,std::string()))
+			_writtenAckSeq = _ackedSeq;
+	}
+
+	if (_unsynced)
+	{
+#ifdef WIN32
+		_commit(_fileno(_file));
+#else
+		fsync(fileno(_file));
+#endif
+		_unsynced = false;
+	}
+}
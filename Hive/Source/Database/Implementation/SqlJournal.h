@@ -0,0 +1,82 @@
+/*
+* Copyright (C) 2009-2012 Rajko Stojadinovic <http://github.com/rajkosto/hive>
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*/
+
+#pragma once
+
+#include "Shared/Common/Types.h"
+
+#include <Poco/Mutex.h>
+#include <cstdio>
+
+namespace Poco { class Logger; };
+
+//Append-only file of the async write statements, so the ones still queued when the process dies aren't lost
+//every record has a sequence number, acknowledged ones are skipped on replay, and the file is emptied once everything is
+class SqlJournal
+{
+public:
+	SqlJournal(Poco::Logger& logger);
+	~SqlJournal();
+
+	struct Entry
+	{
+		UInt64 seq;
+		//more than one means they were a transaction
+		std::vector<std::string> statements;
+	};
+	typedef std::vector<Entry> Entries;
+
+	//opens the journal, outputting what was written but never acknowledged the last time
+	//those are kept in the new file, so acknowledge them once they've been run
+	bool open(const std::string& fileName, Entries& outUnacked);
+	void close();
+	bool isOpen() const { return (_file != nullptr); }
+
+	//returns the sequence number of the record, 0 if it couldn't be written
+	UInt64 append(const std::vector<std::string>& statements);
+	UInt64 append(const std::string& sql);
+	//everything up to (and including) seq has been run, recorded in the file right away
+	void acknowledge(UInt64 seq);
+
+	//flushes the file to disk
+	//the file is emptied if there's nothing left unacknowledged
+	void sync();
+
+	//records not acknowledged yet
+	UInt64 pending() const;
+private:
+	enum RecordType
+	{
+		RECORD_STATEMENTS = 'S',
+		RECORD_ACK = 'A'
+	};
+	bool writeRecord(UInt8 type, UInt64 seq, const std::string& payload);
+
+	Poco::Logger& _logger;
+	std::string _fileName;
+	FILE* _file;
+
+	UInt64 _lastSeq;		//last one written
+	UInt64 _ackedSeq;		//last one acknowledged
+	UInt64 _writtenAckSeq;	//last acknowledgement in the file
+	bool _unsynced;
+
+	typedef Poco::FastMutex LockType;
+	typedef Poco::ScopedLock<LockType> GuardType;
+	mutable LockType _lock;
+};
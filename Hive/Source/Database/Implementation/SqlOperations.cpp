@@ -27,13 +27,20 @@
 
 #include "ConcreteDatabase.h"
 #include "RetrySqlOp.h"
+#include "SqlJournal.h"
 
 
 // ---- ASYNC STATEMENTS / TRANSACTIONS ----
 bool SqlOperation::execute( SqlConnection& sqlConn )
 {
 	SqlConnection::Lock guard(sqlConn);
-	return rawExecute(sqlConn);
+	bool result = rawExecute(sqlConn);
+
+	//if the database is down, this will be run again later
+	if (_journal && (result || !sqlConn.getDB().inOutage()))
+		_journal->acknowledge(_journalSeq);
+
+	return result;
 }
 
 bool SqlPlainRequest::rawExecute(SqlConnection& sqlConn, bool throwExc)
@@ -48,7 +55,16 @@ bool SqlTransaction::rawExecute(SqlConnection& sqlConn, bool throwExc)
 	if(_queue.empty())
 		return true;
 
-	for (;;)
+	//don't bother while the database is down
+	if (!sqlConn.getDB().available())
+	{
+		if (throwExc)
+			throw SqlConnection::SqlException(0,"Database unreachable","SqlTransaction",true);
+
+		return false;
+	}
+
+	for (size_t tries=1;;tries++)
 	{
 		try
 		{
@@ -68,6 +84,7 @@ bool SqlTransaction::rawExecute(SqlConnection& sqlConn, bool throwExc)
 			}
 
 			poco_assert(sqlConn.transactionCommit() == true);
+			sqlConn.getDB().connectionRestored();
 		
 			//whole transaction came through, which means all the callbacks have good data
 			for (size_t i=0; i<callUsWhenDone.size(); i++)
@@ -101,7 +118,7 @@ bool SqlTransaction::rawExecute(SqlConnection& sqlConn, bool throwExc)
 
 			if (throwExc)
 				throw e;
-			else if (e.isRepeatable())
+			else if (e.isRepeatable() && tries < Retry::MAX_TRIES)
 				continue;
 			else
 				return false;
@@ -113,6 +130,9 @@ bool SqlTransaction::rawExecute(SqlConnection& sqlConn, bool throwExc)
 
 bool SqlPreparedRequest::rawExecute(SqlConnection& sqlConn, bool throwExc)
 {
+	//the expensive parts of the parameters are left for here
+	_params.resolveDeferred();
+
 	return Retry::SqlOp<bool>(sqlConn.getDB().getLogger(),[&](SqlConnection& c){ return c.executeStmt(_id, _params); }, throwExc)
 		(sqlConn,"PreparedRequest",[&](){ return sqlConn.getStmt(_id)->getSqlString(true); });
 }
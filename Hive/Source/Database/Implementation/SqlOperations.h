@@ -31,13 +31,18 @@ class Database;
 class SqlConnection;
 class SqlDelayThread;
 class SqlStmtParameters;
+class SqlJournal;
 
 class SqlOperation
 {
 public:
+	SqlOperation() : _journal(nullptr), _journalSeq(0) {}
 	virtual void onRemove() { delete this; }
 	bool execute(SqlConnection& sqlConn);
 	virtual ~SqlOperation() {}
+
+	//recorded in the journal under seq, which gets acknowledged once this has run
+	void setJournalled(SqlJournal* journal, UInt64 seq) { _journal = journal; _journalSeq = seq; }
 protected:
 	friend class SqlTransaction;
 	//execute as a single thing
@@ -49,6 +54,9 @@ protected:
 		//execute normally, but throw exc on error so we dont retry
 		this->rawExecute(sqlConn,true);
 	}
+private:
+	SqlJournal* _journal;
+	UInt64 _journalSeq;
 };
 
 // ---- ASYNC STATEMENTS / TRANSACTIONS ----
@@ -71,10 +79,16 @@ public:
 	~SqlTransaction() {};
 
 	void queueOperation(SqlOperation* sql) { _queue.push_back(sql); }
+	bool empty() const { return _queue.empty(); }
+
+	//sql of the writes in the transaction, for the journal
+	void addJournalSql(std::string sql) { _journalSql.push_back(std::move(sql)); }
+	const std::vector<std::string>& journalSql() const { return _journalSql; }
 protected:
 	bool rawExecute(SqlConnection& sqlConn, bool throwExc) override;
 private:
 	boost::ptr_vector<SqlOperation> _queue;
+	std::vector<std::string> _journalSql;
 };
 
 class SqlPreparedRequest : public SqlOperation
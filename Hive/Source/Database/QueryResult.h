@@ -47,6 +47,7 @@ public:
 
 	virtual size_t numFields() const = 0;
 	//this will also return number of affected rows for non-SELECT statements
+	//for streamed results, this is the number of rows fetched so far
 	virtual UInt64 numRows() const = 0;
 
 	//gets the field names using vendor-specific calls
@@ -56,6 +57,9 @@ public:
 	//false return value means that there's no more results
 	//after this returns false, all the result information is invalid
 	virtual bool nextResult() = 0;
+
+	//true if a streamed result broke off before all of its rows were read
+	virtual bool failed() const { return false; }
 protected:
 	Field _dummyField;
 };
@@ -106,6 +110,8 @@ public:
 		return resultValid;
 	};
 
+	bool failed() const override { return _actualRes->failed(); }
+
 protected:
 	unique_ptr<QueryResult> _actualRes;
 	QueryFieldNames _fieldNames;
@@ -21,8 +21,12 @@
 #include "Shared/Common/Types.h"
 #include "Shared/Common/Exception.h"
 #include <boost/variant.hpp>
+#include <boost/function.hpp>
 #include <sstream>
 
+//string parameter that's only produced when the statement gets run, which is on the async thread for async statements
+typedef boost::function<std::string()> DeferredString;
+
 class SqlStmtField
 {
 public:
@@ -41,6 +45,7 @@ public:
 		FIELD_DOUBLE,
 		FIELD_STRING,
 		FIELD_BINARY,
+		FIELD_DEFERRED,
 		FIELD_COUNT
 	};
 
@@ -55,6 +60,7 @@ public:
 
 	void set(std::string val);
 	void set(ByteVector val);
+	void set(DeferredString val);
 	void set(const UInt8* data, size_t size);
 	void set(const char* str, size_t strSize);
 
@@ -74,6 +80,13 @@ public:
 	const char*			toCStr() const		{ return toString().c_str(); }
 	const ByteVector&	toVector() const	{ return boost::get<const ByteVector&>(_data); }
 
+	//turns a deferred string into a regular one
+	void resolve()
+	{
+		std::string val = boost::get<DeferredString>(_data)();
+		_data = std::move(val);
+	}
+
 	//get type of data
 	Type type() const 
 	{ 
@@ -92,6 +105,7 @@ public:
 			Type operator ()(double) const				{ return FIELD_DOUBLE; }
 			Type operator ()(const std::string&) const	{ return FIELD_STRING; }
 			Type operator ()(const ByteVector&) const	{ return FIELD_BINARY; }
+			Type operator ()(const DeferredString&) const	{ return FIELD_DEFERRED; }
 		};
 
 		return boost::apply_visitor(TypeVisitor(),_data);
@@ -120,6 +134,7 @@ public:
 
 				return nullptr;
 			}
+			const void* operator ()(const DeferredString&) const	{ return nullptr; }
 		};
 
 		return boost::apply_visitor(BufferVisitor(), _data);
@@ -143,6 +158,7 @@ public:
 			size_t operator ()(double) const					{ return sizeof(double); }
 			size_t operator ()(const std::string& data) const	{ return data.length(); }
 			size_t operator ()(const ByteVector& data) const	{ return data.size(); }
+			size_t operator ()(const DeferredString&) const		{ return 0; }
 		};
 
 		return boost::apply_visitor(SizeVisitor(),_data);
@@ -151,7 +167,7 @@ public:
 private:
 	typedef boost::variant< std::string, ByteVector, 
 		bool, UInt8, UInt16, UInt32, UInt64, 
-		Int8, Int16, Int32, Int64, float, double > FieldVariant;
+		Int8, Int16, Int32, Int64, float, double, DeferredString > FieldVariant;
 
 	FieldVariant _data;
 };
@@ -172,6 +188,7 @@ template<> inline void SqlStmtField::set(const char* val) { _data = std::string(
 
 inline void SqlStmtField::set(std::string val) { _data = std::move(val); }
 inline void SqlStmtField::set(ByteVector val) { _data = std::move(val); }
+inline void SqlStmtField::set(DeferredString val) { _data = std::move(val); }
 inline void SqlStmtField::set(const UInt8* data, size_t size) 
 {
 	ByteVector localData(size);
@@ -223,6 +240,15 @@ public:
 		if(numArguments > 0)
 			_params.reserve(numArguments);
 	}
+	//produces the strings of all the deferred parameters, has to be done before binding
+	void resolveDeferred()
+	{
+		for (auto it=_params.begin(); it!=_params.end(); ++it)
+		{
+			if (it->type() == SqlStmtField::FIELD_DEFERRED)
+				it->resolve();
+		}
+	}
 	//swaps contents of internal param container
 	void swap(SqlStmtParameters& obj)
 	{
@@ -330,6 +356,7 @@ public:
 	void addString(std::string var) { arg(std::move(var)); }
 	void addString(std::ostringstream& ss) { arg(ss.str()); ss.str(std::string()); }
 	void addString(const char* var, size_t size)  { arg(var,size); }
+	void addDeferredString(DeferredString producer) { arg(std::move(producer)); }
 	void addBinary(const UInt8* data, size_t size) { arg(data,size); }
 	void addBinary(ByteVector data) { arg(std::move(data)); }
 private:
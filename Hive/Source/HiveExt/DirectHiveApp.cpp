@@ -25,6 +25,26 @@ DirectHiveApp::DirectHiveApp(string suffixDir) : HiveExtApp(suffixDir) {}
 #include "HiveLib/DataSource/SqlObjDataSource.h"
 #include "HiveLib/DataSource/CustomDataSource.h"
 
+bool DirectHiveApp::openJournal(Database& db, Poco::Util::AbstractConfiguration* dbConf)
+{
+	//async writes that haven't been run yet survive a crash when this is set
+	string fileName = dbConf->getString("Journal","");
+	if (fileName.empty())
+		return true;
+
+	int syncInterval = dbConf->getInt("JournalSyncInterval",1000);
+	if (syncInterval < 0)
+		syncInterval = 0;
+
+	if (!db.openJournal(fileName,static_cast<UInt32>(syncInterval)))
+	{
+		logger().critical("Unable to open the write journal " + fileName);
+		return false;
+	}
+
+	return true;
+}
+
 bool DirectHiveApp::initialiseService()
 {
 	//Load up databases
@@ -32,19 +52,32 @@ bool DirectHiveApp::initialiseService()
 		Poco::AutoPtr<Poco::Util::AbstractConfiguration> globalDBConf(config().createView("Database"));
 		Poco::AutoPtr<Poco::Util::AbstractConfiguration> objDBConf(config().createView("ObjectDB"));
 
+		//the object load can use more than one connection at once
+		size_t objConns = 1;
+		{
+			int loadConns = config().getInt("Objects.LoadConnections",1);
+			if (loadConns > 1)
+				objConns = static_cast<size_t>(loadConns);
+		}
+		bool separateObjDb = objDBConf->getBool("Use",false);
+
 		try
 		{
 			Poco::Logger& dbLogger = Poco::Logger::get("Database");
 			_charDb = DatabaseLoader::Create(globalDBConf);
-			if (!_charDb->initialise(dbLogger,DatabaseLoader::MakeConnParams(globalDBConf)))
+			if (!_charDb->initialise(dbLogger,DatabaseLoader::MakeConnParams(globalDBConf),false,"",separateObjDb ? 1 : objConns))
+				return false;
+			if (!openJournal(*_charDb,globalDBConf))
 				return false;
 
 			_objDb = _charDb;
-			if (objDBConf->getBool("Use",false))
+			if (separateObjDb)
 			{
 				Poco::Logger& objDBLogger = Poco::Logger::get("ObjectDB");
 				_objDb = DatabaseLoader::Create(objDBConf);
-				if (!_objDb->initialise(objDBLogger,DatabaseLoader::MakeConnParams(objDBConf)))
+				if (!_objDb->initialise(objDBLogger,DatabaseLoader::MakeConnParams(objDBConf),false,"",objConns))
+					return false;
+				if (!openJournal(*_objDb,objDBConf))
 					return false;
 			}
 		}
@@ -55,19 +88,36 @@ bool DirectHiveApp::initialiseService()
 		}
 	}
 
+	//character and vault money, kept together by both datasources
+	auto ledger = make_shared<CurrencyLedger>(logger());
+	{
+		string fileName = config().getString("Database.MoneyJournal","");
+		if (!fileName.empty() && !ledger->open(fileName))
+		{
+			logger().critical("Unable to open the money journal " + fileName);
+			return false;
+		}
+	}
+
 	//Create character datasource
 	{
 		static const string defaultID = "PlayerUID";
 		static const string defaultWS = "Worldspace";
 
 		Poco::AutoPtr<Poco::Util::AbstractConfiguration> charDBConf(config().createView("Characters"));
-		_charData.reset(new SqlCharDataSource(logger(),_charDb,charDBConf->getString("IDField",defaultID),charDBConf->getString("WSField",defaultWS)));	
+		int cacheIdleMins = charDBConf->getInt("CacheIdleTime",30);
+		UInt32 cacheIdleExpiry = (cacheIdleMins > 0) ? static_cast<UInt32>(cacheIdleMins)*60*1000 : 0;
+		long flushInterval = charDBConf->getInt("FlushInterval",5) * 1000;
+		int prefetchSecs = charDBConf->getInt("PrefetchTime",60);
+		UInt32 prefetchTTL = (prefetchSecs > 0) ? static_cast<UInt32>(prefetchSecs)*1000 : 0;
+		_charData.reset(new SqlCharDataSource(logger(),_charDb,charDBConf->getString("IDField",defaultID),charDBConf->getString("WSField",defaultWS),
+			ledger,cacheIdleExpiry,flushInterval,prefetchTTL));
 	}
 
 	//Create object datasource
 	{
 		Poco::AutoPtr<Poco::Util::AbstractConfiguration> objConf(config().createView("Objects"));
-		_objData.reset(new SqlObjDataSource(logger(),_objDb,objConf.get()));
+		_objData.reset(new SqlObjDataSource(logger(),_objDb,objConf.get(),ledger));
 	}
 
 	_customData.reset(new CustomDataSource(logger(), _objDb));
@@ -78,3 +128,14 @@ bool DirectHiveApp::initialiseService()
 	
 	return true;
 }
+
+vector<Database*> DirectHiveApp::getDatabases() const
+{
+	vector<Database*> dbs;
+	if (_charDb)
+		dbs.push_back(_charDb.get());
+	if (_objDb && _objDb != _charDb)
+		dbs.push_back(_objDb.get());
+
+	return dbs;
+}
@@ -28,6 +28,9 @@ public:
 	DirectHiveApp(string suffixDir);
 protected:
 	bool initialiseService() override;
+	vector<Database*> getDatabases() const override;
 private:
+	bool openJournal(Database& db, Poco::Util::AbstractConfiguration* dbConf);
+
 	shared_ptr<Database> _charDb, _objDb;
 };
\ No newline at end of file
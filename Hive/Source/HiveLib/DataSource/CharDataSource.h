@@ -28,10 +28,46 @@ public:
 	virtual Sqf::Value fetchCharacters( string playerId ) = 0;
 	virtual Sqf::Value fetchCharacterInitial( string playerId, int serverId, const string& playerName, int characterSlot ) = 0;
 	virtual Sqf::Value fetchCharacterDetails( int characterId ) = 0;
+	//[CharacterID,<what 102 returns>] for each of the characters, in the same order
+	typedef deque<Sqf::Parameters> DetailsQueue;
+	virtual void fetchCharacterDetailsBulk( const vector<int>& characterIds, DetailsQueue& outDetails ) = 0;
 	virtual Sqf::Value fetchTraderObject( int traderObjectId, int action ) = 0;
-	typedef map<string,Sqf::Value> FieldsType;
-	virtual bool updateCharacter( int characterId, int serverId, const FieldsType& fields ) = 0;
-	virtual bool initCharacter( int characterId, const Sqf::Value& inventory, const Sqf::Value& backpack ) = 0;
+
+	//fields a character update can change, each one is a bit of the FieldsType mask
+	enum CharField
+	{
+		CHAR_WORLDSPACE,
+		CHAR_INVENTORY,
+		CHAR_BACKPACK,
+		CHAR_MEDICAL,
+		CHAR_JUSTATE,
+		CHAR_JUSTDRANK,
+		CHAR_KILLSZ,
+		CHAR_HEADSHOTSZ,
+		CHAR_DISTANCEFOOT,
+		CHAR_DURATION,
+		CHAR_CURRENTSTATE,
+		CHAR_KILLSH,
+		CHAR_KILLSB,
+		CHAR_MODEL,
+		CHAR_HUMANITY,
+		CHAR_MONEY,
+		NUM_CHAR_FIELDS
+	};
+	struct FieldsType
+	{
+		FieldsType() : mask(0) {}
+
+		bool has(CharField field) const { return (mask & (1u << field)) != 0; }
+		void set(CharField field, Sqf::Value val) { values[field] = std::move(val); mask |= (1u << field); }
+		void unset(CharField field) { mask &= ~(1u << field); }
+		bool empty() const { return (mask == 0); }
+
+		UInt32 mask;
+		Sqf::Value values[NUM_CHAR_FIELDS];
+	};
+	virtual bool updateCharacter( int characterId, int serverId, FieldsType fields ) = 0;
+	virtual bool initCharacter( int characterId, Sqf::Value inventory, Sqf::Value backpack ) = 0;
 	virtual bool killCharacter( int characterId, int duration, int infected ) = 0;
 	virtual bool recordLogin( string playerId, int characterId, int action ) = 0;
 protected:
@@ -0,0 +1,143 @@
+/*
+* Copyright (C) 2009-2012 Rajko Stojadinovic <http://github.com/rajkosto/hive>
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*/
+
+#include "CharacterCache.h"
+#include "Shared/Common/Timer.h"
+
+#include <boost/lexical_cast.hpp>
+
+CharacterCache::CharacterCache(UInt32 idleExpiry) : _idleExpiry(idleExpiry), _lastExpiry(GlobalTimer::getMSTime()), _hits(0), _misses(0) {}
+
+int CharacterCache::MinutesSince(const Poco::Timestamp& when)
+{
+	return static_cast<int>(when.elapsed() / (Poco::Timestamp::resolution()*60));
+}
+
+Poco::Timestamp CharacterCache::MinutesAgo(int minutes)
+{
+	return Poco::Timestamp() - static_cast<Poco::Timestamp::TimeDiff>(minutes)*Poco::Timestamp::resolution()*60;
+}
+
+void CharacterCache::expireIdle()
+{
+	UInt32 now = GlobalTimer::getMSTime();
+	//no point going through all of them on every call
+	if (GlobalTimer::getMSTimeDiff(_lastExpiry,now) < 60*1000)
+		return;
+
+	_lastExpiry = now;
+	for (auto it=_entries.begin(); it!=_entries.end();)
+	{
+		if (GlobalTimer::getMSTimeDiff(it->second.lastUsed,now) > _idleExpiry)
+		{
+			_bySlot.erase(SlotKey(it->second.playerId,it->second.slot));
+			it = _entries.erase(it);
+		}
+		else
+			++it;
+	}
+}
+
+CharacterCache::Entry* CharacterCache::touch(Entry& entry)
+{
+	entry.lastUsed = GlobalTimer::getMSTime();
+	return &entry;
+}
+
+CharacterCache::Entry* CharacterCache::find(int characterId)
+{
+	if (!enabled())
+		return nullptr;
+
+	expireIdle();
+
+	auto it = _entries.find(characterId);
+	if (it == _entries.end())
+		return nullptr;
+
+	return touch(it->second);
+}
+
+CharacterCache::Entry* CharacterCache::findLive(const string& playerId, int slot)
+{
+	if (!enabled())
+		return nullptr;
+
+	expireIdle();
+
+	auto slotIt = _bySlot.find(SlotKey(playerId,slot));
+	if (slotIt == _bySlot.end())
+		return nullptr;
+
+	auto it = _entries.find(slotIt->second);
+	if (it == _entries.end())
+	{
+		_bySlot.erase(slotIt);
+		return nullptr;
+	}
+
+	return touch(it->second);
+}
+
+CharacterCache::Entry* CharacterCache::insert(int characterId, const string& playerId, int slot)
+{
+	if (!enabled())
+		return nullptr;
+
+	remove(characterId);
+
+	//a new character in the slot means the old one is gone
+	SlotKey slotKey(playerId,slot);
+	auto slotIt = _bySlot.find(slotKey);
+	if (slotIt != _bySlot.end())
+	{
+		_entries.erase(slotIt->second);
+		_bySlot.erase(slotIt);
+	}
+
+	Entry& entry = _entries[characterId];
+	entry.characterId = characterId;
+	entry.playerId = playerId;
+	entry.slot = slot;
+	entry.lastUsed = GlobalTimer::getMSTime();
+	_bySlot[slotKey] = characterId;
+
+	return &entry;
+}
+
+void CharacterCache::remove(int characterId)
+{
+	auto it = _entries.find(characterId);
+	if (it == _entries.end())
+		return;
+
+	auto slotIt = _bySlot.find(SlotKey(it->second.playerId,it->second.slot));
+	if (slotIt != _bySlot.end() && slotIt->second == characterId)
+		_bySlot.erase(slotIt);
+
+	_entries.erase(it);
+}
+
+string CharacterCache::stats() const
+{
+	using boost::lexical_cast;
+
+	UInt64 total = _hits + _misses;
+	UInt64 hitPercent = (total > 0) ? (_hits*100 / total) : 0;
+	return lexical_cast<string>(_hits) + " of " + lexical_cast<string>(total) + " lookups served from memory (" + lexical_cast<string>(hitPercent) + "%)";
+}
@@ -0,0 +1,110 @@
+/*
+* Copyright (C) 2009-2012 Rajko Stojadinovic <http://github.com/rajkosto/hive>
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*/
+
+#pragma once
+
+#include "Shared/Common/Types.h"
+#include "../Sqf.h"
+
+#include <Poco/Timestamp.h>
+
+//State of the live characters, so logins and detail loads of characters already in play don't need the database
+//only used from the calling thread, like the rest of the character data source
+class CharacterCache
+{
+public:
+	typedef shared_ptr<const Sqf::Value> ValuePtr;
+
+	//what 102 returns, only known once it's been loaded
+	struct Details
+	{
+		Details() : generation(1), killsZ(0), headshotsZ(0), killsH(0), killsB(0), humanity(2500), instance(1), money(0) {}
+
+		ValuePtr medical;
+		int generation;
+		int killsZ;
+		int headshotsZ;
+		int killsH;
+		int killsB;
+		ValuePtr currentState;
+		int humanity;
+		int instance;
+		int money;
+	};
+	struct Entry
+	{
+		Entry() : characterId(0), slot(0), hasDetails(false), lastUsed(0) {}
+
+		int characterId;
+		string playerId;
+		string playerName;
+		int slot;
+
+		ValuePtr worldSpace;
+		ValuePtr inventory;
+		ValuePtr backpack;
+		string model;
+
+		//for the survival times 101 returns
+		Poco::Timestamp aliveSince;
+		Poco::Timestamp lastLogin;
+		Poco::Timestamp lastAte;
+		Poco::Timestamp lastDrank;
+
+		bool hasDetails;
+		Details details;
+
+		UInt32 lastUsed;
+	};
+
+	//characters not used for this long (in ms) are dropped, 0 turns the cache off
+	CharacterCache(UInt32 idleExpiry);
+	~CharacterCache() {}
+
+	bool enabled() const { return (_idleExpiry > 0); }
+
+	//null if the character isn't cached
+	Entry* find(int characterId);
+	//the alive character in that slot of the player
+	Entry* findLive(const string& playerId, int slot);
+	//replaces whatever was cached for the character, null if the cache is off
+	Entry* insert(int characterId, const string& playerId, int slot);
+	void remove(int characterId);
+
+	size_t size() const { return _entries.size(); }
+	//whether a request could be answered from the cache, for the hit rate in the logs
+	void record(bool hit) { if (hit) _hits++; else _misses++; }
+	string stats() const;
+
+	static int MinutesSince(const Poco::Timestamp& when);
+	static Poco::Timestamp MinutesAgo(int minutes);
+private:
+	void expireIdle();
+	Entry* touch(Entry& entry);
+
+	typedef map<int,Entry> EntryMap;
+	EntryMap _entries;
+	typedef std::pair<string,int> SlotKey;
+	map<SlotKey,int> _bySlot;
+
+	UInt32 _idleExpiry;
+	UInt32 _lastExpiry;
+
+	UInt64 _hits;
+	UInt64 _misses;
+};
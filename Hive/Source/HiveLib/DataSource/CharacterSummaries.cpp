@@ -0,0 +1,138 @@
+/*
+* Copyright (C) 2009-2012 Rajko Stojadinovic <http://github.com/rajkosto/hive>
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*/
+
+#include "CharacterSummaries.h"
+#include "Shared/Common/Timer.h"
+
+#include <boost/lexical_cast.hpp>
+
+CharacterSummaries::CharacterSummaries(UInt32 idleExpiry) : _idleExpiry(idleExpiry), _lastExpiry(GlobalTimer::getMSTime()), _hits(0), _misses(0) {}
+
+void CharacterSummaries::expireIdle()
+{
+	UInt32 now = GlobalTimer::getMSTime();
+	//no point going through all of them on every call
+	if (GlobalTimer::getMSTimeDiff(_lastExpiry,now) < 60*1000)
+		return;
+
+	_lastExpiry = now;
+	for (auto it=_players.begin(); it!=_players.end();)
+	{
+		if (GlobalTimer::getMSTimeDiff(it->second.lastUsed,now) > _idleExpiry)
+		{
+			const SlotMap& slots = it->second.slots;
+			for (auto slotIt=slots.cbegin(); slotIt!=slots.cend(); ++slotIt)
+				_byCharacter.erase(slotIt->second.characterId);
+
+			it = _players.erase(it);
+		}
+		else
+			++it;
+	}
+}
+
+void CharacterSummaries::removePlayer(const string& playerId)
+{
+	auto it = _players.find(playerId);
+	if (it == _players.end())
+		return;
+
+	const SlotMap& slots = it->second.slots;
+	for (auto slotIt=slots.cbegin(); slotIt!=slots.cend(); ++slotIt)
+		_byCharacter.erase(slotIt->second.characterId);
+
+	_players.erase(it);
+}
+
+const CharacterSummaries::SlotMap* CharacterSummaries::find(const string& playerId)
+{
+	if (!enabled())
+		return nullptr;
+
+	expireIdle();
+
+	auto it = _players.find(playerId);
+	if (it == _players.end())
+		return nullptr;
+
+	it->second.lastUsed = GlobalTimer::getMSTime();
+	return &it->second.slots;
+}
+
+const CharacterSummaries::SlotMap* CharacterSummaries::set(const string& playerId, const SlotMap& slots)
+{
+	if (!enabled())
+		return nullptr;
+
+	removePlayer(playerId);
+
+	Player& player = _players[playerId];
+	player.slots = slots;
+	player.lastUsed = GlobalTimer::getMSTime();
+	for (auto it=slots.cbegin(); it!=slots.cend(); ++it)
+		_byCharacter[it->second.characterId] = playerId;
+
+	return &player.slots;
+}
+
+CharacterSummaries::Slot* CharacterSummaries::findCharacter(int characterId)
+{
+	auto charIt = _byCharacter.find(characterId);
+	if (charIt == _byCharacter.end())
+		return nullptr;
+
+	auto it = _players.find(charIt->second);
+	if (it == _players.end())
+		return nullptr;
+
+	SlotMap& slots = it->second.slots;
+	for (auto slotIt=slots.begin(); slotIt!=slots.end(); ++slotIt)
+	{
+		if (slotIt->second.characterId == characterId)
+			return &slotIt->second;
+	}
+
+	return nullptr;
+}
+
+CharacterSummaries::Slot* CharacterSummaries::replaceSlot(const string& playerId, int slot, int characterId)
+{
+	auto it = _players.find(playerId);
+	if (it == _players.end())
+		return nullptr;
+
+	//the previous character isn't listed anymore
+	Slot& newSlot = it->second.slots[slot];
+	_byCharacter.erase(newSlot.characterId);
+
+	newSlot = Slot();
+	newSlot.characterId = characterId;
+	newSlot.slot = slot;
+	_byCharacter[characterId] = playerId;
+
+	return &newSlot;
+}
+
+string CharacterSummaries::stats() const
+{
+	using boost::lexical_cast;
+
+	UInt64 total = _hits + _misses;
+	UInt64 hitPercent = (total > 0) ? (_hits*100 / total) : 0;
+	return lexical_cast<string>(_hits) + " of " + lexical_cast<string>(total) + " character lists served from memory (" + lexical_cast<string>(hitPercent) + "%)";
+}
@@ -0,0 +1,96 @@
+/*
+* Copyright (C) 2009-2012 Rajko Stojadinovic <http://github.com/rajkosto/hive>
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*/
+
+#pragma once
+
+#include "Shared/Common/Types.h"
+#include "CharacterCache.h"
+
+#include <Poco/Timestamp.h>
+
+//What 100 lists for each player: the latest character in every slot, dead or alive
+//loaded once per player, then kept current by the logins, updates and deaths that go through the hive
+//only used from the calling thread, like the rest of the character data source
+class CharacterSummaries
+{
+public:
+	struct Slot
+	{
+		Slot() : characterId(0), slot(0), alive(true), generation(1), humanity(2500), 
+			killsZ(0), headshotsZ(0), killsH(0), killsB(0), distanceFoot(0), infected(0) {}
+
+		int characterId;
+		int slot;
+		CharacterCache::ValuePtr worldSpace;
+		bool alive;
+		int generation;
+		int humanity;
+		int killsZ;
+		int headshotsZ;
+		int killsH;
+		int killsB;
+		int distanceFoot;
+		string model;
+		int infected;
+
+		Poco::Timestamp aliveSince;
+		Poco::Timestamp lastLogin;
+	};
+	//by slot number
+	typedef map<int,Slot> SlotMap;
+
+	//players not asked about for this long (in ms) are dropped, 0 turns the summaries off
+	CharacterSummaries(UInt32 idleExpiry);
+	~CharacterSummaries() {}
+
+	bool enabled() const { return (_idleExpiry > 0); }
+
+	//null if the characters of that player haven't been loaded
+	const SlotMap* find(const string& playerId);
+	//replaces what is known about the player, null if the summaries are off
+	const SlotMap* set(const string& playerId, const SlotMap& slots);
+
+	//the character, if it's the latest in its slot of a loaded player
+	Slot* findCharacter(int characterId);
+	//a new character in a slot of the player, ignored if the player isn't loaded
+	Slot* replaceSlot(const string& playerId, int slot, int characterId);
+
+	size_t size() const { return _players.size(); }
+	//whether 100 could be answered from memory, for the hit rate in the logs
+	void record(bool hit) { if (hit) _hits++; else _misses++; }
+	string stats() const;
+private:
+	void expireIdle();
+	void removePlayer(const string& playerId);
+
+	struct Player
+	{
+		SlotMap slots;
+		UInt32 lastUsed;
+	};
+	typedef map<string,Player> PlayerMap;
+	PlayerMap _players;
+	//PlayerUID of each character in the slots above
+	map<int,string> _byCharacter;
+
+	UInt32 _idleExpiry;
+	UInt32 _lastExpiry;
+
+	UInt64 _hits;
+	UInt64 _misses;
+};
@@ -0,0 +1,434 @@
+/*
+* Copyright (C) 2009-2012 Rajko Stojadinovic <http://github.com/rajkosto/hive>
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*/
+
+#include "CurrencyLedger.h"
+
+#include <Poco/Logger.h>
+#include <Poco/File.h>
+#include <Poco/Exception.h>
+#include <Poco/Timestamp.h>
+#include <boost/lexical_cast.hpp>
+#include <climits>
+#include <sstream>
+
+#ifdef WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+using boost::lexical_cast;
+
+//one line per record: kind type id seq amount
+//kind is D for a delta, B for a balance, W for what the database took of the account (up to seq),
+//S for where the seqs are at when the journal got rewritten (type, id and amount are 0)
+//a line cut short by the process dying has no newline, and is left out
+namespace
+{
+	bool WriteRecord(FILE* file, char kind, int type, int id, UInt64 seq, int amount)
+	{
+		string line = string(1,kind) + " " + lexical_cast<string>(type) + " " + lexical_cast<string>(id) + " " + 
+			lexical_cast<string>(seq) + " " + lexical_cast<string>(amount) + "\n";
+		if (fwrite(line.data(),1,line.length(),file) != line.length())
+			return false;
+
+		//into the OS right away, so it survives the process dying
+		return (fflush(file) == 0);
+	}
+
+	bool SyncFile(FILE* file)
+	{
+#ifdef WIN32
+		return (_commit(_fileno(file)) == 0);
+#else
+		return (fsync(fileno(file)) == 0);
+#endif
+	}
+
+	//writes in a row that find no row before the account is given up on
+	const int MAX_MISSED_WRITES = 3;
+};
+
+CurrencyLedger::CurrencyLedger(Poco::Logger& logger) : _lastSeq(0), _changes(0), _written(0), _dropped(0), _logger(logger), _file(nullptr) {}
+
+CurrencyLedger::~CurrencyLedger()
+{
+	if (_file)
+		fclose(_file);
+}
+
+bool CurrencyLedger::open(const string& fileName)
+{
+	GuardType guard(_lock);
+	_fileName = fileName;
+
+	if (FILE* oldFile = fopen(_fileName.c_str(),"rb"))
+	{
+		string contents;
+		char buf[4096];
+		size_t numRead;
+		while ((numRead = fread(buf,1,sizeof(buf),oldFile)) > 0)
+			contents.append(buf,numRead);
+		fclose(oldFile);
+
+		size_t lineStart = 0;
+		for (size_t lineEnd; (lineEnd = contents.find('\n',lineStart)) != string::npos; lineStart = lineEnd+1)
+		{
+			std::istringstream line(contents.substr(lineStart,lineEnd-lineStart));
+			char kind;
+			int type, id, amount;
+			UInt64 seq;
+			if (!(line >> kind >> type >> id >> seq >> amount) || type < 0 || type >= NUM_ACCOUNT_TYPES)
+			{
+				_logger.warning("Money journal " + _fileName + " has a damaged line, skipping it");
+				continue;
+			}
+
+			if (seq > _lastSeq)
+				_lastSeq = seq;
+			if (kind == 'S')
+				continue;
+
+			//same order as they were made in
+			AccountKey key(type,id);
+			if (kind == 'W')
+			{
+				auto it = _accounts.find(key);
+				if (it == _accounts.end())
+					continue;
+
+				vector<Change>& left = it->second.left;
+				size_t numWritten = 0;
+				while (numWritten < left.size() && left[numWritten].seq <= seq)
+					numWritten++;
+				left.erase(left.begin(),left.begin()+numWritten);
+				if (left.empty())
+					_accounts.erase(it);
+			}
+			else
+			{
+				_accounts[key].left.push_back(Change(seq,amount,(kind == 'B')));
+				_changes++;
+			}
+		}
+	}
+
+	//a new journal starts off the clock, so the seqs of different hives don't line up
+	if (_lastSeq == 0)
+		_lastSeq = static_cast<UInt64>(Poco::Timestamp().epochMicroseconds());
+
+	if (!_accounts.empty())
+		_logger.information("Money journal " + _fileName + " has changes of " + lexical_cast<string>(_accounts.size()) + " accounts the last run didn't write");
+
+	compact();
+	return (_file != nullptr);
+}
+
+UInt64 CurrencyLedger::nextSeq()
+{
+	//kept going by the journal, never by the clock
+	return ++_lastSeq;
+}
+
+bool CurrencyLedger::change(AccountType type, int id, int amount, bool absolute)
+{
+	GuardType guard(_lock);
+
+	Account& account = _accounts[AccountKey(type,id)];
+	account.absolute = absolute;
+	account.amount = absolute ? amount : (account.amount + amount);
+	account.seq = nextSeq();
+	_changes++;
+
+	if (!_file)
+		return false;
+
+	if (!WriteRecord(_file,absolute ? 'B' : 'D',type,id,account.seq,amount))
+	{
+		_logger.error("Unable to write to money journal " + _fileName + ", money changes are written out right away now");
+		fclose(_file);
+		_file = nullptr;
+		return false;
+	}
+
+	return true;
+}
+
+void CurrencyLedger::written(const AccountKey& key, int amount, UInt64 seq)
+{
+	auto it = _accounts.find(key);
+	if (it == _accounts.end())
+		return;
+
+	//changes made while writing have a newer seq, and go out next time
+	Account& account = it->second;
+	if (account.seq <= seq)
+		_accounts.erase(it);
+	else
+	{
+		if (!account.absolute)
+			account.amount -= amount;
+		account.missedWrites = 0;
+	}
+}
+
+bool CurrencyLedger::add(AccountType type, int id, int delta)
+{
+	return change(type,id,delta,false);
+}
+
+bool CurrencyLedger::set(AccountType type, int id, int balance)
+{
+	return change(type,id,balance,true);
+}
+
+int CurrencyLedger::unwritten(AccountType type, int id) const
+{
+	GuardType guard(_lock);
+
+	//the left changes aren't counted, the row might have them already
+	auto it = _accounts.find(AccountKey(type,id));
+	if (it == _accounts.end() || it->second.absolute)
+		return 0;
+
+	return it->second.amount;
+}
+
+bool CurrencyLedger::resolveLeft(const AccountKey& key, const SeqFunc& readSeq)
+{
+	//the last run might have died between the write and its W record
+	UInt64 rowSeq = 0;
+	if (!readSeq(key.second,rowSeq))
+		return false;
+
+	GuardType guard(_lock);
+	auto it = _accounts.find(key);
+	if (it == _accounts.end())
+		return true;
+
+	Account& account = it->second;
+	vector<Change>& left = account.left;
+	for (size_t i=0; i<left.size(); i++)
+	{
+		//each write covers all changes up to its seq
+		if (left[i].seq == rowSeq)
+		{
+			_logger.information("Money of account " + lexical_cast<string>(key.first) + ":" + lexical_cast<string>(key.second) + 
+				" already has " + lexical_cast<string>(i+1) + " of the changes the last run left");
+			left.erase(left.begin(),left.begin()+i+1);
+			break;
+		}
+	}
+
+	Account merged;
+	for (auto chIt=left.cbegin(); chIt!=left.cend(); ++chIt)
+	{
+		merged.absolute = chIt->absolute;
+		merged.amount = chIt->absolute ? chIt->amount : (merged.amount + chIt->amount);
+		merged.seq = chIt->seq;
+	}
+	if (account.seq != 0)
+	{
+		merged.absolute = merged.absolute || account.absolute;
+		merged.amount = account.absolute ? account.amount : (merged.amount + account.amount);
+		merged.seq = account.seq;
+	}
+
+	if (merged.seq == 0)
+		_accounts.erase(it);
+	else
+		account = merged;
+
+	return true;
+}
+
+bool CurrencyLedger::writeOut(AccountType type, const vector<int>& ids, const WriteFunc& write, const SeqFunc& readSeq)
+{
+	bool allWritten = true;
+	for (auto it=ids.cbegin(); it!=ids.cend(); ++it)
+	{
+		AccountKey key(type,*it);
+		Account toWrite;
+		{
+			GuardType guard(_lock);
+			auto accIt = _accounts.find(key);
+			if (accIt == _accounts.end())
+				continue;
+
+			toWrite = accIt->second;
+		}
+
+		if (!toWrite.left.empty())
+		{
+			if (!resolveLeft(key,readSeq))
+			{
+				allWritten = false;
+				continue;
+			}
+
+			GuardType guard(_lock);
+			auto accIt = _accounts.find(key);
+			if (accIt == _accounts.end())
+				continue;
+
+			toWrite = accIt->second;
+		}
+
+		//a failed one stays as it is, and goes out with its newer changes next time
+		WriteResult res = write(*it,toWrite.amount,toWrite.seq);
+		if (res == WRITE_FAILED)
+		{
+			allWritten = false;
+			continue;
+		}
+
+		GuardType guard(_lock);
+		if (res == WRITE_NO_ROW)
+		{
+			auto accIt = _accounts.find(key);
+			if (accIt == _accounts.end())
+				continue;
+
+			string accountName = lexical_cast<string>(type) + ":" + lexical_cast<string>(*it);
+			if (++accIt->second.missedWrites < MAX_MISSED_WRITES)
+			{
+				_logger.warning("Money of account " + accountName + " found no row to go to, trying again later");
+				allWritten = false;
+				continue;
+			}
+
+			_logger.error("Money of account " + accountName + " found no row to go to " + lexical_cast<string>(MAX_MISSED_WRITES) + 
+				" times, dropping " + lexical_cast<string>(toWrite.amount));
+			_dropped++;
+		}
+		else
+			_written++;
+
+		written(key,toWrite.amount,toWrite.seq);
+
+		//a replay has to know that part is gone, or it would write it again along with the newer changes
+		if (_file && !WriteRecord(_file,'W',type,*it,toWrite.seq,toWrite.amount))
+		{
+			fclose(_file);
+			_file = nullptr;
+		}
+	}
+
+	//rewritten with just what's left, which is cheap when nothing is
+	GuardType guard(_lock);
+	if (_accounts.empty() || ids.size() > 1 || !_file)
+		compact();
+
+	return allWritten;
+}
+
+bool CurrencyLedger::flush(AccountType type, const WriteFunc& write, const SeqFunc& readSeq)
+{
+	GuardType flushGuard(_flushLock);
+
+	vector<int> ids;
+	{
+		GuardType guard(_lock);
+		auto it = _accounts.lower_bound(AccountKey(type,INT_MIN));
+		for (; it!=_accounts.end() && it->first.first == type; ++it)
+			ids.push_back(it->first.second);
+	}
+
+	if (ids.empty())
+		return true;
+
+	return writeOut(type,ids,write,readSeq);
+}
+
+bool CurrencyLedger::flush(AccountType type, int id, const WriteFunc& write, const SeqFunc& readSeq)
+{
+	GuardType flushGuard(_flushLock);
+	return writeOut(type,vector<int>(1,id),write,readSeq);
+}
+
+void CurrencyLedger::compact()
+{
+	if (_fileName.empty())
+		return;
+
+	if (_file)
+	{
+		fclose(_file);
+		_file = nullptr;
+	}
+
+	if (_accounts.empty())
+	{
+		//the seqs have to keep going up even when nothing is left
+		_file = fopen(_fileName.c_str(),"wb");
+		if (_file && !WriteRecord(_file,'S',0,0,_lastSeq,0))
+		{
+			fclose(_file);
+			_file = nullptr;
+		}
+	}
+	else
+	{
+		//the old one stays until the new one is complete
+		string tmpName = _fileName + ".tmp";
+		FILE* tmpFile = fopen(tmpName.c_str(),"wb");
+		bool complete = (tmpFile != nullptr) && WriteRecord(tmpFile,'S',0,0,_lastSeq,0);
+		for (auto it=_accounts.cbegin(); complete && it!=_accounts.cend(); ++it)
+		{
+			const Account& account = it->second;
+			for (auto chIt=account.left.cbegin(); complete && chIt!=account.left.cend(); ++chIt)
+				complete = WriteRecord(tmpFile,chIt->absolute ? 'B' : 'D',it->first.first,it->first.second,chIt->seq,chIt->amount);
+			if (complete && account.seq != 0)
+				complete = WriteRecord(tmpFile,account.absolute ? 'B' : 'D',it->first.first,it->first.second,account.seq,account.amount);
+		}
+		if (tmpFile)
+		{
+			complete = SyncFile(tmpFile) && complete;
+			fclose(tmpFile);
+		}
+
+		if (complete)
+		{
+			try
+			{
+				Poco::File(tmpName).renameTo(_fileName);
+				_file = fopen(_fileName.c_str(),"ab");
+			}
+			catch (const Poco::Exception& e)
+			{
+				_logger.error("Unable to replace money journal " + _fileName + ": " + e.displayText());
+			}
+		}
+	}
+
+	if (!_file)
+		_logger.error("Unable to write money journal " + _fileName + ", money changes are written out right away now");
+}
+
+string CurrencyLedger::stats() const
+{
+	GuardType guard(_lock);
+	UInt64 coalesced = (_changes > _written) ? (_changes - _written) : 0;
+	UInt64 coalescedPercent = (_changes > 0) ? (coalesced*100 / _changes) : 0;
+	string retVal = lexical_cast<string>(_changes) + " money changes written as " + lexical_cast<string>(_written) + " writes (" + 
+		lexical_cast<string>(coalescedPercent) + "% coalesced), " + lexical_cast<string>(_accounts.size()) + " accounts unwritten";
+	if (_dropped > 0)
+		retVal += ", " + lexical_cast<string>(_dropped) + " dropped for having no row";
+
+	return retVal;
+}
@@ -0,0 +1,121 @@
+/*
+* Copyright (C) 2009-2012 Rajko Stojadinovic <http://github.com/rajkosto/hive>
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*/
+
+#pragma once
+
+#include "Shared/Common/Types.h"
+
+#include <boost/function.hpp>
+#include <Poco/Mutex.h>
+#include <cstdio>
+
+namespace Poco { class Logger; };
+
+//Money changes of everything that holds money, kept in memory and written out in batches by the data source owning each kind
+//every change goes into the journal file before it's answered, and stays there until the database has taken it
+//every change gets a sequence number, counted on in the journal file across restarts, and every write stores the latest one next to the money
+//the changes the last run left are checked against that before they go out again, so what it got written isn't counted twice
+class CurrencyLedger
+{
+public:
+	enum AccountType
+	{
+		ACCOUNT_CHARACTER,	//Character_DATA.Money, changed by 201 deltas
+		ACCOUNT_VAULT,		//Money of the object, set by 600
+		NUM_ACCOUNT_TYPES
+	};
+
+	CurrencyLedger(Poco::Logger& logger);
+	~CurrencyLedger();
+
+	//starts journalling the changes, taking back whatever the last run didn't write out
+	bool open(const string& fileName);
+	//the writes have to store the seq with the money, and report whether they changed the row
+	bool isJournalled() const { return !_fileName.empty(); }
+
+	//both return false if the change couldn't be journalled, write it out right away then
+	bool add(AccountType type, int id, int delta);
+	bool set(AccountType type, int id, int balance);
+	//sum of the deltas not written out yet
+	int unwritten(AccountType type, int id) const;
+
+	enum WriteResult
+	{
+		WRITE_FAILED,	//didn't get to the database, stays for next time
+		WRITE_NO_ROW,	//changed nothing, there's no such row
+		WRITE_DONE
+	};
+	//writes one account, delta or balance depending on its type, seq is that of the latest change included
+	//only done once the database has changed the row, as that's when the journal lets go of it
+	typedef boost::function<WriteResult (int id, int amount, UInt64 seq)> WriteFunc;
+	//reads the seq the row of the account was last written with, 0 if there's no row, false if it couldn't be read
+	typedef boost::function<bool (int id, UInt64& seq)> SeqFunc;
+	//writes out the changed accounts of that type, flushes of the ledger never overlap so the writes stay in order
+	bool flush(AccountType type, const WriteFunc& write, const SeqFunc& readSeq);
+	//writes out just that account, if it has changed
+	bool flush(AccountType type, int id, const WriteFunc& write, const SeqFunc& readSeq);
+
+	string stats() const;
+private:
+	struct Change
+	{
+		Change(UInt64 seq, int amount, bool absolute) : seq(seq), amount(amount), absolute(absolute) {}
+
+		UInt64 seq;
+		int amount;
+		bool absolute;
+	};
+	struct Account
+	{
+		Account() : amount(0), absolute(false), seq(0), missedWrites(0) {}
+
+		int amount;		//delta, or balance if absolute
+		bool absolute;
+		UInt64 seq;		//of the latest change, 0 if there's none besides the left ones
+		//changes the last run left, some of them might have been written before it died
+		vector<Change> left;
+		int missedWrites;	//in a row, that found no row
+	};
+	typedef std::pair<int,int> AccountKey;	//type,id
+	typedef map<AccountKey,Account> AccountMap;
+	AccountMap _accounts;
+	UInt64 _lastSeq;
+
+	UInt64 _changes;
+	UInt64 _written;
+	UInt64 _dropped;
+
+	UInt64 nextSeq();
+	bool change(AccountType type, int id, int amount, bool absolute);
+	//takes out what a write covered
+	void written(const AccountKey& key, int amount, UInt64 seq);
+	//leaves out the left changes the row already has, and merges the rest with the newer ones
+	bool resolveLeft(const AccountKey& key, const SeqFunc& readSeq);
+	bool writeOut(AccountType type, const vector<int>& ids, const WriteFunc& write, const SeqFunc& readSeq);
+
+	Poco::Logger& _logger;
+	string _fileName;
+	FILE* _file;
+	//rewrites the journal with just the changes still unwritten
+	void compact();
+
+	typedef Poco::FastMutex LockType;
+	typedef Poco::ScopedLock<LockType> GuardType;
+	mutable LockType _lock;
+	LockType _flushLock;
+};
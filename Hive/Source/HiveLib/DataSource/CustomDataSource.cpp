@@ -18,7 +18,12 @@ void CustomDataSource::populateQuery(string query, Sqf::Parameters& params, Cust
 		query = boost::algorithm::replace_nth_copy(query, "?", i, Sqf::GetStringAny(params.at(i)));
 	}
 
-	auto custRes = getDB()->queryParams(query.c_str());
+	auto custRes = getDB()->queryStreamedParams(query.c_str());
+	if (!custRes)
+	{
+		_logger.error("Failed to fetch custom data from database");
+		return;
+	}
 
 	while (custRes->fetchRow())
 	{
@@ -38,7 +43,14 @@ void CustomDataSource::populateQuery(string query, Sqf::Parameters& params, Cust
 			}
 		}
 
-		queue.push(custParams);
+		queue.push_back(std::move(custParams));
+	}
+
+	//a partial result is worse than none
+	if (custRes->failed())
+	{
+		_logger.error("Custom data stream broke off after " + lexical_cast<string>(queue.size()) + " rows");
+		queue.clear();
 	}
 }
 bool CustomDataSource::customExecute(string query, Sqf::Parameters& params) {
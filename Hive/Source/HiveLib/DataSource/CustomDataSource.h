@@ -6,7 +6,7 @@
 class CustomDataSource : public SqlDataSource
 {
 public:
-	typedef std::queue<Sqf::Parameters> CustomDataQueue;
+	typedef deque<Sqf::Parameters> CustomDataQueue;
 
 	CustomDataSource(Poco::Logger& logger, shared_ptr<Database> db);
 	~CustomDataSource();
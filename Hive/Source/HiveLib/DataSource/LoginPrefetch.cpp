@@ -0,0 +1,130 @@
+/*
+* Copyright (C) 2009-2012 Rajko Stojadinovic <http://github.com/rajkosto/hive>
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*/
+
+#include "LoginPrefetch.h"
+#include "Database/QueryResult.h"
+
+#include <boost/lexical_cast.hpp>
+#include <Poco/Exception.h>
+
+LoginPrefetch::LoginPrefetch(UInt32 ttl) : _ttl(ttl), _pool("LoginPrefetch",1,4), _hits(0), _misses(0) {}
+
+LoginPrefetch::~LoginPrefetch()
+{
+	for (auto it=_fetches.begin(); it!=_fetches.end(); ++it)
+		it->second->done.wait();
+
+	_pool.joinAll();
+}
+
+void LoginPrefetch::Fetch::run()
+{
+	try
+	{
+		result = func();
+	}
+	catch (...)
+	{
+		result.reset();
+	}
+	done.set();
+}
+
+void LoginPrefetch::expire()
+{
+	Poco::Timestamp::TimeDiff maxAge = static_cast<Poco::Timestamp::TimeDiff>(_ttl)*1000;
+	for (auto it=_fetches.begin(); it!=_fetches.end();)
+	{
+		//the pool is still using the ones that haven't finished
+		if ((it->second->stale || it->second->started.isElapsed(maxAge)) && it->second->done.tryWait(0))
+			it = _fetches.erase(it);
+		else
+			++it;
+	}
+}
+
+void LoginPrefetch::start(const string& playerId, int slot, int characterId, FetchFunc fetch)
+{
+	if (!enabled())
+		return;
+
+	expire();
+
+	SlotKey key(playerId,slot);
+	if (_fetches.count(key) > 0)
+		return;
+
+	shared_ptr<Fetch> newFetch = make_shared<Fetch>(characterId,std::move(fetch));
+	try
+	{
+		_pool.start(*newFetch);
+	}
+	catch (const Poco::NoThreadAvailableException&)
+	{
+		return;
+	}
+
+	_fetches[key] = std::move(newFetch);
+}
+
+void LoginPrefetch::invalidate(int characterId)
+{
+	//the running ones can't be dropped yet, they're left for expire()
+	for (auto it=_fetches.begin(); it!=_fetches.end(); ++it)
+	{
+		if (it->second->characterId == characterId)
+			it->second->stale = true;
+	}
+}
+
+unique_ptr<QueryResult> LoginPrefetch::take(const string& playerId, int slot)
+{
+	if (!enabled())
+		return nullptr;
+
+	expire();
+
+	auto it = _fetches.find(SlotKey(playerId,slot));
+	if (it == _fetches.end())
+	{
+		_misses++;
+		return nullptr;
+	}
+
+	shared_ptr<Fetch> fetch = it->second;
+	_fetches.erase(it);
+
+	fetch->done.wait();
+	if (!fetch->result || fetch->stale || fetch->started.isElapsed(static_cast<Poco::Timestamp::TimeDiff>(_ttl)*1000))
+	{
+		_misses++;
+		return nullptr;
+	}
+
+	_hits++;
+	return std::move(fetch->result);
+}
+
+string LoginPrefetch::stats() const
+{
+	using boost::lexical_cast;
+
+	UInt64 total = _hits + _misses;
+	UInt64 hitPercent = (total > 0) ? (_hits*100 / total) : 0;
+	return lexical_cast<string>(_hits) + " of " + lexical_cast<string>(total) + " logins were prefetched (" + lexical_cast<string>(hitPercent) + "%)";
+}
@@ -0,0 +1,78 @@
+/*
+* Copyright (C) 2009-2012 Rajko Stojadinovic <http://github.com/rajkosto/hive>
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*/
+
+#pragma once
+
+#include "Shared/Common/Types.h"
+
+#include <boost/function.hpp>
+#include <Poco/Event.h>
+#include <Poco/Runnable.h>
+#include <Poco/ThreadPool.h>
+#include <Poco/Timestamp.h>
+
+class QueryResult;
+//Results of the 101 login query, fetched in the background as soon as 100 says which player is coming
+//only used from the calling thread, the fetches themselves run on the pool
+class LoginPrefetch
+{
+public:
+	typedef boost::function<unique_ptr<QueryResult>()> FetchFunc;
+
+	//results not taken within ttl ms are dropped, 0 turns prefetching off
+	LoginPrefetch(UInt32 ttl);
+	//waits for the fetches still running
+	~LoginPrefetch();
+
+	bool enabled() const { return (_ttl > 0); }
+
+	//does nothing if that slot is already being fetched, or there's no thread free for it
+	void start(const string& playerId, int slot, int characterId, FetchFunc fetch);
+	//a write to the character makes what was fetched of it old, it's thrown away
+	void invalidate(int characterId);
+	//waits for the fetch if it's still running, null if there was none (or it failed or expired)
+	unique_ptr<QueryResult> take(const string& playerId, int slot);
+
+	//how many logins found their data already fetched, for the logs
+	string stats() const;
+private:
+	struct Fetch : public Poco::Runnable
+	{
+		Fetch(int characterId, FetchFunc fetchFunc) : characterId(characterId), func(std::move(fetchFunc)), done(false), stale(false) {}
+		void run() override;
+
+		int characterId;
+		FetchFunc func;
+		unique_ptr<QueryResult> result;
+		Poco::Event done;
+		Poco::Timestamp started;
+		bool stale;
+	};
+	typedef std::pair<string,int> SlotKey;
+	typedef map< SlotKey,shared_ptr<Fetch> > FetchMap;
+	FetchMap _fetches;
+
+	//drops the expired and stale ones that aren't running anymore
+	void expire();
+
+	UInt32 _ttl;
+	Poco::ThreadPool _pool;
+
+	UInt64 _hits;
+	UInt64 _misses;
+};
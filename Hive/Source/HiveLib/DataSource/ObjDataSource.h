@@ -25,16 +25,22 @@ class ObjDataSource
 public:
 	virtual ~ObjDataSource() {}
 
-	typedef std::queue<Sqf::Parameters> ServerObjectsQueue;
-	virtual void populateObjects( int serverId, ServerObjectsQueue& queue ) = 0;
+	typedef deque<Sqf::Parameters> ServerObjectsQueue;
+	//false if the objects couldn't all be loaded, the queue is left empty then
+	virtual bool populateObjects( int serverId, ServerObjectsQueue& queue ) = 0;
 	virtual void populateTraderObjects( int characterId, ServerObjectsQueue& queue ) = 0;
-	virtual bool updateObjectInventory( int serverId, Int64 objectIdent, bool byUID, const Sqf::Value& inventory ) = 0;
+	virtual bool updateObjectInventory( int serverId, Int64 objectIdent, bool byUID, Sqf::Value inventory ) = 0;
 	virtual bool deleteObject( int serverId, Int64 objectIdent, bool byUID ) = 0;
 	virtual bool updateMoney( int money, int vaultId ) = 0;
 	virtual bool updateDatestampObject( int serverId, Int64 objectIdent, bool byUID ) = 0;
-	virtual bool updateVehicleMovement( int serverId, Int64 objectIdent, const Sqf::Value& worldspace, double fuel ) = 0;
-	virtual bool updateVehicleStatus( int serverId, Int64 objectIdent, const Sqf::Value& hitPoints, double damage ) = 0;
-	virtual bool createObject( int serverId, const string& className, double damage, int characterId, 
-		const Sqf::Value& worldSpace, const Sqf::Value& inventory, const Sqf::Value& hitPoints, double fuel, Int64 uniqueId ) = 0;
+	virtual bool updateDatestampObjects( int serverId, const vector<Int64>& objectIdents, bool byUID ) = 0;
+	virtual bool updateVehicleMovement( int serverId, Int64 objectIdent, Sqf::Value worldspace, double fuel ) = 0;
+	virtual bool updateVehicleStatus( int serverId, Int64 objectIdent, Sqf::Value hitPoints, double damage ) = 0;
+	//["PASS",objectId] if the ObjectID is known right away, ["PASS"] if it has to be fetched by UID later
+	virtual Sqf::Value createObject( int serverId, const string& className, double damage, int characterId, 
+		Sqf::Value worldSpace, Sqf::Value inventory, Sqf::Value hitPoints, double fuel, Int64 uniqueId ) = 0;
 	virtual Sqf::Value fetchObjectId( int serverId, Int64 objectUID ) = 0;
+	virtual Sqf::Value fetchObjectsNear( double x, double y, double radius ) = 0;
+	//["PASS",count,[objectIds]], count includes objects whose ObjectID hasn't been fetched yet
+	virtual Sqf::Value fetchOwnedObjects( int characterId ) = 0;
 };
\ No newline at end of file
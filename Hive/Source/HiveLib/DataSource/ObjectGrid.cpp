@@ -0,0 +1,263 @@
+/*
+* Copyright (C) 2009-2012 Rajko Stojadinovic <http://github.com/rajkosto/hive>
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*/
+
+#include "ObjectGrid.h"
+
+#include <algorithm>
+#include <cmath>
+
+ObjectGrid::ObjectGrid(double cellSize) : _cellSize(cellSize)
+{
+	if (_cellSize <= 0)
+		_cellSize = 100.0;
+}
+
+void ObjectGrid::reset(double cellSize)
+{
+	GuardType guard(_lock);
+
+	_cells.clear();
+	_uidToId.clear();
+	_pending.clear();
+	_items.clear();
+
+	if (cellSize > 0)
+		_cellSize = cellSize;
+}
+
+size_t ObjectGrid::size() const
+{
+	GuardType guard(_lock);
+	return _items.size() + _pending.size();
+}
+
+ObjectGrid::CellKey ObjectGrid::makeKey(Int64 cellX, Int64 cellY)
+{
+	return static_cast<CellKey>((static_cast<UInt64>(cellX) << 32) | (static_cast<UInt64>(cellY) & 0xFFFFFFFF));
+}
+
+ObjectGrid::CellKey ObjectGrid::cellFor(double x, double y) const
+{
+	return makeKey(static_cast<Int64>(std::floor(x/_cellSize)),static_cast<Int64>(std::floor(y/_cellSize)));
+}
+
+void ObjectGrid::link(Item& item)
+{
+	item.cell = cellFor(item.x,item.y);
+	_cells[item.cell].push_back(&item);
+}
+
+void ObjectGrid::unlink(const Item& item)
+{
+	auto cellIt = _cells.find(item.cell);
+	if (cellIt == _cells.end())
+		return;
+
+	auto& cellItems = cellIt->second;
+	auto it = std::find(cellItems.begin(),cellItems.end(),&item);
+	if (it != cellItems.end())
+	{
+		*it = cellItems.back();
+		cellItems.pop_back();
+	}
+	if (cellItems.empty())
+		_cells.erase(cellIt);
+}
+
+void ObjectGrid::insert(Int64 objectId, Int64 objectUid, const string& className, double x, double y)
+{
+	GuardType guard(_lock);
+
+	auto existing = _items.find(objectId);
+	if (existing != _items.end())
+	{
+		unlink(existing->second);
+		_items.erase(existing);
+	}
+
+	Item& item = _items[objectId];
+	item.objectId = objectId;
+	item.objectUid = objectUid;
+	item.className = className;
+	item.x = x;
+	item.y = y;
+	link(item);
+
+	//vehicles all have UID 0
+	if (objectUid != 0)
+		_uidToId[objectUid] = objectId;
+}
+
+void ObjectGrid::insertPending(Int64 objectUid, const string& className, double x, double y)
+{
+	GuardType guard(_lock);
+
+	auto existing = _pending.find(objectUid);
+	if (existing != _pending.end())
+	{
+		unlink(existing->second);
+		_pending.erase(existing);
+	}
+
+	Item& item = _pending[objectUid];
+	item.objectId = 0;
+	item.objectUid = objectUid;
+	item.className = className;
+	item.x = x;
+	item.y = y;
+	link(item);
+}
+
+bool ObjectGrid::resolvePending(Int64 objectUid, Int64 objectId)
+{
+	string className;
+	double x, y;
+	{
+		GuardType guard(_lock);
+
+		auto it = _pending.find(objectUid);
+		if (it == _pending.end())
+			return false;
+
+		className = it->second.className;
+		x = it->second.x;
+		y = it->second.y;
+
+		unlink(it->second);
+		_pending.erase(it);
+	}
+
+	insert(objectId,objectUid,className,x,y);
+	return true;
+}
+
+bool ObjectGrid::move(Int64 objectId, double x, double y)
+{
+	GuardType guard(_lock);
+
+	auto it = _items.find(objectId);
+	if (it == _items.end())
+		return false;
+
+	Item& item = it->second;
+	item.x = x;
+	item.y = y;
+	if (cellFor(x,y) != item.cell)
+	{
+		unlink(item);
+		link(item);
+	}
+
+	return true;
+}
+
+bool ObjectGrid::remove(Int64 objectId)
+{
+	GuardType guard(_lock);
+
+	auto it = _items.find(objectId);
+	if (it == _items.end())
+		return false;
+
+	unlink(it->second);
+	if (it->second.objectUid != 0)
+		_uidToId.erase(it->second.objectUid);
+
+	_items.erase(it);
+	return true;
+}
+
+bool ObjectGrid::removeByUID(Int64 objectUid)
+{
+	Int64 objectId = 0;
+	{
+		GuardType guard(_lock);
+
+		auto pendIt = _pending.find(objectUid);
+		if (pendIt != _pending.end())
+		{
+			unlink(pendIt->second);
+			_pending.erase(pendIt);
+			return true;
+		}
+
+		auto uidIt = _uidToId.find(objectUid);
+		if (uidIt == _uidToId.end())
+			return false;
+
+		objectId = uidIt->second;
+	}
+
+	return remove(objectId);
+}
+
+vector<ObjectGrid::Match> ObjectGrid::queryRadius(double x, double y, double radius) const
+{
+	vector<Match> results;
+	if (radius < 0)
+		return results;
+
+	GuardType guard(_lock);
+
+	const double radiusSq = radius*radius;
+	auto scanCell = [&](const vector<const Item*>& cellItems)
+	{
+		for (auto it=cellItems.cbegin(); it!=cellItems.cend(); ++it)
+		{
+			const Item& item = **it;
+			double dx = item.x - x;
+			double dy = item.y - y;
+			double distSq = dx*dx + dy*dy;
+			if (distSq > radiusSq)
+				continue;
+
+			Match match;
+			match.objectId = item.objectId;
+			match.className = item.className;
+			match.distance = std::sqrt(distSq);
+			results.push_back(std::move(match));
+		}
+	};
+
+	double minX = std::floor((x-radius)/_cellSize);
+	double maxX = std::floor((x+radius)/_cellSize);
+	double minY = std::floor((y-radius)/_cellSize);
+	double maxY = std::floor((y+radius)/_cellSize);
+
+	//if the radius covers more cells than we have populated, just go through all of them
+	if ((maxX-minX+1)*(maxY-minY+1) > static_cast<double>(_cells.size()))
+	{
+		for (auto cellIt=_cells.cbegin(); cellIt!=_cells.cend(); ++cellIt)
+			scanCell(cellIt->second);
+	}
+	else
+	{
+		for (Int64 cellX=static_cast<Int64>(minX); cellX<=static_cast<Int64>(maxX); cellX++)
+		{
+			for (Int64 cellY=static_cast<Int64>(minY); cellY<=static_cast<Int64>(maxY); cellY++)
+			{
+				auto cellIt = _cells.find(makeKey(cellX,cellY));
+				if (cellIt != _cells.end())
+					scanCell(cellIt->second);
+			}
+		}
+	}
+
+	std::sort(results.begin(),results.end(),[](const Match& a, const Match& b) { return a.distance < b.distance; });
+	return results;
+}
\ No newline at end of file
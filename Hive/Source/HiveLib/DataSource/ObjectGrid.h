@@ -0,0 +1,85 @@
+/*
+* Copyright (C) 2009-2012 Rajko Stojadinovic <http://github.com/rajkosto/hive>
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*/
+
+#pragma once
+
+#include "Shared/Common/Types.h"
+
+#include <boost/unordered_map.hpp>
+#include <Poco/Mutex.h>
+
+//Uniform grid over the map positions of the objects, keyed by ObjectID
+//Objects published this session are only known by their UID, until their ID gets fetched
+class ObjectGrid
+{
+public:
+	ObjectGrid(double cellSize = 100.0);
+	~ObjectGrid() {}
+
+	//removes all the objects, and changes the cell size if specified
+	void reset(double cellSize = 0);
+	size_t size() const;
+
+	void insert(Int64 objectId, Int64 objectUid, const string& className, double x, double y);
+	void insertPending(Int64 objectUid, const string& className, double x, double y);
+	//gives a pending object its ObjectID
+	bool resolvePending(Int64 objectUid, Int64 objectId);
+
+	bool move(Int64 objectId, double x, double y);
+	bool remove(Int64 objectId);
+	bool removeByUID(Int64 objectUid);
+
+	struct Match
+	{
+		Int64 objectId; //0 if still pending
+		string className;
+		double distance;
+	};
+	//sorted by distance, closest first
+	vector<Match> queryRadius(double x, double y, double radius) const;
+private:
+	typedef Int64 CellKey;
+	CellKey cellFor(double x, double y) const;
+	static CellKey makeKey(Int64 cellX, Int64 cellY);
+
+	struct Item
+	{
+		Int64 objectId;
+		Int64 objectUid;
+		string className;
+		double x, y;
+		CellKey cell;
+	};
+	void link(Item& item);
+	void unlink(const Item& item);
+
+	double _cellSize;
+
+	//node based containers, so the pointers in the cells stay valid
+	typedef boost::unordered_map<Int64,Item> ItemMap;
+	ItemMap _items;		//by ObjectID
+	ItemMap _pending;	//by ObjectUID
+	boost::unordered_map<Int64,Int64> _uidToId;
+
+	typedef boost::unordered_map< CellKey,vector<const Item*> > CellMap;
+	CellMap _cells;
+
+	typedef Poco::FastMutex LockType;
+	typedef Poco::ScopedLock<LockType> GuardType;
+	mutable LockType _lock;
+};
\ No newline at end of file
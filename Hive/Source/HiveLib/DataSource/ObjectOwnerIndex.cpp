@@ -0,0 +1,179 @@
+/*
+* Copyright (C) 2009-2012 Rajko Stojadinovic <http://github.com/rajkosto/hive>
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*/
+
+#include "ObjectOwnerIndex.h"
+
+void ObjectOwnerIndex::clear()
+{
+	GuardType guard(_lock);
+	_owners.clear();
+	_byId.clear();
+	_uidToIds.clear();
+	_pendingOwners.clear();
+}
+
+void ObjectOwnerIndex::unlinkOwner(OwnerMap::iterator ownerIt)
+{
+	if (ownerIt->second.ids.empty() && ownerIt->second.pendingUids.empty())
+		_owners.erase(ownerIt);
+}
+
+void ObjectOwnerIndex::insert(int characterId, Int64 objectId, Int64 objectUid)
+{
+	//no owner (vehicles and such)
+	if (characterId == 0 || objectId <= 0)
+		return;
+
+	GuardType guard(_lock);
+
+	auto existing = _byId.find(objectId);
+	if (existing != _byId.end())
+	{
+		if (existing->second.owner == characterId)
+			return;
+
+		auto ownerIt = _owners.find(existing->second.owner);
+		if (ownerIt != _owners.end())
+		{
+			ownerIt->second.ids.erase(objectId);
+			unlinkOwner(ownerIt);
+		}
+	}
+	else if (objectUid != 0)
+		_uidToIds.insert(std::make_pair(objectUid,objectId));
+
+	Entry& entry = _byId[objectId];
+	entry.owner = characterId;
+	entry.uid = objectUid;
+	_owners[characterId].ids.insert(objectId);
+}
+
+void ObjectOwnerIndex::insertPending(int characterId, Int64 objectUid)
+{
+	if (characterId == 0 || objectUid == 0)
+		return;
+
+	GuardType guard(_lock);
+	_pendingOwners.insert(std::make_pair(objectUid,characterId));
+	_owners[characterId].pendingUids.insert(objectUid);
+}
+
+void ObjectOwnerIndex::resolvePending(Int64 objectUid, Int64 objectId)
+{
+	int characterId = 0;
+	{
+		GuardType guard(_lock);
+
+		//only one of the pending objects with this UID can be this ObjectID
+		auto it = _pendingOwners.find(objectUid);
+		if (it == _pendingOwners.end())
+			return;
+
+		characterId = it->second;
+		_pendingOwners.erase(it);
+
+		auto ownerIt = _owners.find(characterId);
+		if (ownerIt != _owners.end())
+		{
+			auto uidIt = ownerIt->second.pendingUids.find(objectUid);
+			if (uidIt != ownerIt->second.pendingUids.end())
+				ownerIt->second.pendingUids.erase(uidIt);
+
+			unlinkOwner(ownerIt);
+		}
+	}
+
+	insert(characterId,objectId,objectUid);
+}
+
+void ObjectOwnerIndex::remove(Int64 objectId)
+{
+	GuardType guard(_lock);
+
+	auto it = _byId.find(objectId);
+	if (it == _byId.end())
+		return;
+
+	auto ownerIt = _owners.find(it->second.owner);
+	if (ownerIt != _owners.end())
+	{
+		ownerIt->second.ids.erase(objectId);
+		unlinkOwner(ownerIt);
+	}
+
+	if (it->second.uid != 0)
+	{
+		auto range = _uidToIds.equal_range(it->second.uid);
+		for (auto uidIt=range.first; uidIt!=range.second; ++uidIt)
+		{
+			if (uidIt->second == objectId)
+			{
+				_uidToIds.erase(uidIt);
+				break;
+			}
+		}
+	}
+
+	_byId.erase(it);
+}
+
+void ObjectOwnerIndex::removeByUID(Int64 objectUid)
+{
+	if (objectUid == 0)
+		return;
+
+	vector<Int64> objectIds;
+	{
+		GuardType guard(_lock);
+
+		auto pendRange = _pendingOwners.equal_range(objectUid);
+		for (auto it=pendRange.first; it!=pendRange.second; ++it)
+		{
+			auto ownerIt = _owners.find(it->second);
+			if (ownerIt == _owners.end())
+				continue;
+
+			ownerIt->second.pendingUids.erase(objectUid);
+			unlinkOwner(ownerIt);
+		}
+		_pendingOwners.erase(pendRange.first,pendRange.second);
+
+		auto idRange = _uidToIds.equal_range(objectUid);
+		for (auto it=idRange.first; it!=idRange.second; ++it)
+			objectIds.push_back(it->second);
+	}
+
+	for (auto it=objectIds.cbegin(); it!=objectIds.cend(); ++it)
+		remove(*it);
+}
+
+vector<Int64> ObjectOwnerIndex::find(int characterId, size_t& numPending) const
+{
+	vector<Int64> objectIds;
+	numPending = 0;
+
+	GuardType guard(_lock);
+
+	auto ownerIt = _owners.find(characterId);
+	if (ownerIt == _owners.end())
+		return objectIds;
+
+	objectIds.assign(ownerIt->second.ids.cbegin(),ownerIt->second.ids.cend());
+	numPending = ownerIt->second.pendingUids.size();
+	return objectIds;
+}
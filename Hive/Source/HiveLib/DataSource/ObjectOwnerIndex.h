@@ -0,0 +1,71 @@
+/*
+* Copyright (C) 2009-2012 Rajko Stojadinovic <http://github.com/rajkosto/hive>
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*/
+
+#pragma once
+
+#include "Shared/Common/Types.h"
+
+#include <boost/unordered_map.hpp>
+#include <set>
+#include <Poco/Mutex.h>
+
+//CharacterID to objects owned by it, for the objects of the instance
+//objects published this session are only known by their UID, until their ID gets fetched
+class ObjectOwnerIndex
+{
+public:
+	ObjectOwnerIndex() {}
+	~ObjectOwnerIndex() {}
+
+	void clear();
+
+	void insert(int characterId, Int64 objectId, Int64 objectUid);
+	void insertPending(int characterId, Int64 objectUid);
+	//gives a pending object with this UID its ObjectID
+	void resolvePending(Int64 objectUid, Int64 objectId);
+
+	void remove(Int64 objectId);
+	//removes all the objects with this UID
+	void removeByUID(Int64 objectUid);
+
+	//ObjectIDs owned by the character, numPending gets the ones whose ID isn't known yet
+	vector<Int64> find(int characterId, size_t& numPending) const;
+private:
+	struct Owned
+	{
+		std::set<Int64> ids;
+		std::multiset<Int64> pendingUids;
+	};
+	typedef boost::unordered_map<int,Owned> OwnerMap;
+	OwnerMap _owners;
+
+	struct Entry
+	{
+		int owner;
+		Int64 uid;
+	};
+	boost::unordered_map<Int64,Entry> _byId;
+	boost::unordered_multimap<Int64,Int64> _uidToIds;
+	boost::unordered_multimap<Int64,int> _pendingOwners;	//by ObjectUID
+
+	void unlinkOwner(OwnerMap::iterator ownerIt);
+
+	typedef Poco::FastMutex LockType;
+	typedef Poco::ScopedLock<LockType> GuardType;
+	mutable LockType _lock;
+};
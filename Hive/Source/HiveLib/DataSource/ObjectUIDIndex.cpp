@@ -0,0 +1,141 @@
+/*
+* Copyright (C) 2009-2012 Rajko Stojadinovic <http://github.com/rajkosto/hive>
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*/
+
+#include "ObjectUIDIndex.h"
+
+void ObjectUIDIndex::clear()
+{
+	GuardType guard(_lock);
+	_uidToId.clear();
+	_idToUid.clear();
+}
+
+size_t ObjectUIDIndex::size() const
+{
+	GuardType guard(_lock);
+	return _uidToId.size();
+}
+
+void ObjectUIDIndex::insert(Int64 objectUid, Int64 objectId)
+{
+	//vehicles all have UID 0
+	if (objectUid == 0 || objectId <= 0)
+		return;
+
+	GuardType guard(_lock);
+
+	auto ins = _uidToId.insert(std::make_pair(objectUid,objectId));
+	if (!ins.second)
+	{
+		Int64& existing = ins.first->second;
+		//the pending object has got its ID
+		if (existing == ID_PENDING)
+			existing = objectId;
+		else if (existing != objectId)
+			existing = ID_AMBIGUOUS;
+	}
+	_idToUid[objectId] = objectUid;
+}
+
+void ObjectUIDIndex::insertPending(Int64 objectUid)
+{
+	if (objectUid == 0)
+		return;
+
+	GuardType guard(_lock);
+
+	auto ins = _uidToId.insert(std::make_pair(objectUid,static_cast<Int64>(ID_PENDING)));
+	//there's another object with this UID now
+	if (!ins.second && ins.first->second != ID_PENDING)
+		ins.first->second = ID_AMBIGUOUS;
+}
+
+Int64 ObjectUIDIndex::find(Int64 objectUid) const
+{
+	GuardType guard(_lock);
+
+	auto it = _uidToId.find(objectUid);
+	if (it == _uidToId.end() || it->second <= 0)
+		return 0;
+
+	return it->second;
+}
+
+vector<Int64> ObjectUIDIndex::findAll(Int64 objectUid) const
+{
+	GuardType guard(_lock);
+
+	vector<Int64> objectIds;
+	auto it = _uidToId.find(objectUid);
+	if (it == _uidToId.end() || it->second == ID_PENDING)
+		return objectIds;
+
+	if (it->second != ID_AMBIGUOUS)
+		objectIds.push_back(it->second);
+	else
+	{
+		for (auto idIt=_idToUid.cbegin(); idIt!=_idToUid.cend(); ++idIt)
+		{
+			if (idIt->second == objectUid)
+				objectIds.push_back(idIt->first);
+		}
+	}
+
+	return objectIds;
+}
+
+void ObjectUIDIndex::remove(Int64 objectId)
+{
+	GuardType guard(_lock);
+
+	auto it = _idToUid.find(objectId);
+	if (it == _idToUid.end())
+		return;
+
+	auto uidIt = _uidToId.find(it->second);
+	//ambiguous ones stay that way, there could still be others with the same UID
+	if (uidIt != _uidToId.end() && uidIt->second == objectId)
+		_uidToId.erase(uidIt);
+
+	_idToUid.erase(it);
+}
+
+void ObjectUIDIndex::removeByUID(Int64 objectUid)
+{
+	GuardType guard(_lock);
+
+	auto it = _uidToId.find(objectUid);
+	if (it == _uidToId.end())
+		return;
+
+	//deleting by UID gets rid of all the objects with it
+	if (it->second != ID_PENDING && it->second != ID_AMBIGUOUS)
+		_idToUid.erase(it->second);
+	else if (it->second == ID_AMBIGUOUS)
+	{
+		for (auto idIt=_idToUid.begin(); idIt!=_idToUid.end();)
+		{
+			if (idIt->second == objectUid)
+				idIt = _idToUid.erase(idIt);
+			else
+				++idIt;
+		}
+	}
+
+	_uidToId.erase(it);
+}
@@ -0,0 +1,59 @@
+/*
+* Copyright (C) 2009-2012 Rajko Stojadinovic <http://github.com/rajkosto/hive>
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*/
+
+#pragma once
+
+#include "Shared/Common/Types.h"
+
+#include <boost/unordered_map.hpp>
+#include <Poco/Mutex.h>
+
+//ObjectUID to ObjectID lookup for the objects of the instance, so by-UID requests can use the primary key
+//UIDs are made up by the scripts, so the ones that turn up on more than one object are never resolved
+class ObjectUIDIndex
+{
+public:
+	ObjectUIDIndex() {}
+	~ObjectUIDIndex() {}
+
+	void clear();
+	size_t size() const;
+
+	void insert(Int64 objectUid, Int64 objectId);
+	//object was created, but its ObjectID isn't known yet
+	void insertPending(Int64 objectUid);
+
+	//ObjectID for the UID, 0 if it's unknown, pending or ambiguous
+	Int64 find(Int64 objectUid) const;
+	//all the known ObjectIDs with the UID, even if there's more than one
+	vector<Int64> findAll(Int64 objectUid) const;
+
+	void remove(Int64 objectId);
+	void removeByUID(Int64 objectUid);
+private:
+	//special ObjectID values
+	enum { ID_PENDING = 0, ID_AMBIGUOUS = -1 };
+
+	typedef boost::unordered_map<Int64,Int64> IdMap;
+	IdMap _uidToId;
+	IdMap _idToUid;
+
+	typedef Poco::FastMutex LockType;
+	typedef Poco::ScopedLock<LockType> GuardType;
+	mutable LockType _lock;
+};
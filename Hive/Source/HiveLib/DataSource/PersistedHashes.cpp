@@ -0,0 +1,160 @@
+/*
+* Copyright (C) 2009-2012 Rajko Stojadinovic <http://github.com/rajkosto/hive>
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*/
+
+#include "PersistedHashes.h"
+
+#include <boost/lexical_cast.hpp>
+#include <cstring>
+
+namespace
+{
+	//64bit FNV-1a
+	const UInt64 FNV_PRIME = 1099511628211ULL;
+
+	UInt64 HashBytes(const void* data, size_t len, UInt64 hash)
+	{
+		const UInt8* bytes = static_cast<const UInt8*>(data);
+		for (size_t i=0; i<len; i++)
+		{
+			hash ^= bytes[i];
+			hash *= FNV_PRIME;
+		}
+		return hash;
+	}
+};
+
+UInt64 PersistedHashes::Hash(const string& data, UInt64 seed)
+{
+	//length first, so "ab","c" and "a","bc" don't come out the same
+	UInt64 len = data.length();
+	return HashBytes(data.data(),data.length(),HashBytes(&len,sizeof(len),seed));
+}
+
+UInt64 PersistedHashes::Hash(double data, UInt64 seed)
+{
+	UInt64 bits;
+	std::memcpy(&bits,&data,sizeof(bits));
+	return HashBytes(&bits,sizeof(bits),seed);
+}
+
+namespace
+{
+	struct ValueHasher : public boost::static_visitor<UInt64>
+	{
+		ValueHasher(UInt64 seed_) : seed(seed_) {}
+
+		UInt64 operator()(double val) const				{ return PersistedHashes::Hash(val,seed); }
+		UInt64 operator()(int val) const				{ return HashBytes(&val,sizeof(val),seed); }
+		UInt64 operator()(Int64 val) const				{ return HashBytes(&val,sizeof(val),seed); }
+		UInt64 operator()(bool val) const				{ UInt8 byte = val ? 1 : 0; return HashBytes(&byte,sizeof(byte),seed); }
+		UInt64 operator()(const string& val) const		{ return PersistedHashes::Hash(val,seed); }
+		UInt64 operator()(void*) const					{ return seed; }
+		UInt64 operator()(const Sqf::Parameters& arr) const
+		{
+			UInt64 len = arr.size();
+			UInt64 hash = HashBytes(&len,sizeof(len),seed);
+			for (auto it=arr.cbegin(); it!=arr.cend(); ++it)
+				hash = PersistedHashes::Hash(*it,hash);
+
+			return hash;
+		}
+
+		UInt64 seed;
+	};
+};
+
+UInt64 PersistedHashes::Hash(const Sqf::Value& data, UInt64 seed)
+{
+	//the type goes in first, so 1 and "1" don't come out the same
+	int which = data.which();
+	return boost::apply_visitor(ValueHasher(HashBytes(&which,sizeof(which),seed)),data);
+}
+
+bool PersistedHashes::changed(Int64 key, UInt32 column, UInt64 hash)
+{
+	GuardType guard(_lock);
+
+	//no telling which rows the failed writes were for
+	if (_droppedWrites)
+	{
+		UInt32 dropped = _droppedWrites();
+		if (dropped != _lastDropped)
+		{
+			_hashes.clear();
+			_lastDropped = dropped;
+		}
+	}
+
+	ColumnHashes& row = _hashes[key];
+	for (auto it=row.begin(); it!=row.end(); ++it)
+	{
+		if (it->first != column)
+			continue;
+
+		if (it->second == hash)
+		{
+			_hits++;
+			return false;
+		}
+
+		it->second = hash;
+		_misses++;
+		return true;
+	}
+
+	row.push_back(std::make_pair(column,hash));
+	_misses++;
+	return true;
+}
+
+void PersistedHashes::forget(Int64 key, UInt32 column)
+{
+	GuardType guard(_lock);
+
+	auto rowIt = _hashes.find(key);
+	if (rowIt == _hashes.end())
+		return;
+
+	ColumnHashes& row = rowIt->second;
+	for (auto it=row.begin(); it!=row.end(); ++it)
+	{
+		if (it->first == column)
+		{
+			row.erase(it);
+			break;
+		}
+	}
+	if (row.empty())
+		_hashes.erase(rowIt);
+}
+
+void PersistedHashes::forget(Int64 key)
+{
+	GuardType guard(_lock);
+	_hashes.erase(key);
+}
+
+string PersistedHashes::stats() const
+{
+	using boost::lexical_cast;
+
+	GuardType guard(_lock);
+	UInt64 total = _hits + _misses;
+	UInt64 hitPercent = (total > 0) ? (_hits*100 / total) : 0;
+	return lexical_cast<string>(_hits) + " of " + lexical_cast<string>(total) + " writes skipped (" + lexical_cast<string>(hitPercent) + "%)";
+}
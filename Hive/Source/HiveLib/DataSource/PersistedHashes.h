@@ -0,0 +1,67 @@
+/*
+* Copyright (C) 2009-2012 Rajko Stojadinovic <http://github.com/rajkosto/hive>
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*/
+
+#pragma once
+
+#include "Shared/Common/Types.h"
+#include "../Sqf.h"
+
+#include <boost/unordered_map.hpp>
+#include <boost/function.hpp>
+#include <Poco/Mutex.h>
+
+//Hashes of the last values written to each column of a row, so writes that wouldn't change anything can be dropped
+class PersistedHashes
+{
+public:
+	//how many writes have failed for good so far, all the hashes are dropped whenever that goes up
+	typedef boost::function<UInt32()> DroppedFunc;
+	explicit PersistedHashes(DroppedFunc droppedWrites = DroppedFunc()) 
+		: _droppedWrites(std::move(droppedWrites)), _lastDropped(0), _hits(0), _misses(0) {}
+	~PersistedHashes() {}
+
+	static UInt64 Hash(const string& data, UInt64 seed = 14695981039346656037ULL);
+	static UInt64 Hash(double data, UInt64 seed = 14695981039346656037ULL);
+	//goes through the value itself, so it doesn't have to be turned into text first
+	static UInt64 Hash(const Sqf::Value& data, UInt64 seed = 14695981039346656037ULL);
+
+	//records the hash for the column, returns false (and counts a hit) if it's what was written last time
+	//if the write that follows a true return can't be queued, forget the column
+	bool changed(Int64 key, UInt32 column, UInt64 hash);
+	//the row was written to in some other way (or the write failed), so what we know about it is useless now
+	void forget(Int64 key);
+	void forget(Int64 key, UInt32 column);
+
+	//hit rate, for the logs
+	string stats() const;
+private:
+	//rows only have a handful of columns, so those are just searched through
+	typedef vector< std::pair<UInt32,UInt64> > ColumnHashes;
+	typedef boost::unordered_map<Int64,ColumnHashes> HashMap;
+	HashMap _hashes;
+
+	DroppedFunc _droppedWrites;
+	UInt32 _lastDropped;
+
+	UInt64 _hits;
+	UInt64 _misses;
+
+	typedef Poco::FastMutex LockType;
+	typedef Poco::ScopedLock<LockType> GuardType;
+	mutable LockType _lock;
+};
@@ -20,106 +20,305 @@
 #include "Database/Database.h"
 
 #include <boost/lexical_cast.hpp>
+#include <boost/bind.hpp>
+#include <set>
 using boost::lexical_cast;
 using boost::bad_lexical_cast;
 
-SqlCharDataSource::SqlCharDataSource( Poco::Logger& logger, shared_ptr<Database> db, const string& idFieldName, const string& wsFieldName ) : SqlDataSource(logger,db)
+SqlCharDataSource::SqlCharDataSource( Poco::Logger& logger, shared_ptr<Database> db, const string& idFieldName, const string& wsFieldName, 
+	shared_ptr<CurrencyLedger> ledger, UInt32 cacheIdleExpiry, long flushInterval, UInt32 prefetchTTL ) 
+	: SqlDataSource(logger,db), _writtenHashes(boost::bind(&Database::droppedOperations,getDB())), _ledger(std::move(ledger)), _cache(cacheIdleExpiry), _summaries(cacheIdleExpiry), _prefetch(prefetchTTL), _flushInterval(flushInterval)
 {
 	_idFieldName = getDB()->escape(idFieldName);
 	_wsFieldName = getDB()->escape(wsFieldName);
+
+	if (_flushInterval > 0)
+	{
+		_flushTimer.setStartInterval(_flushInterval);
+		_flushTimer.setPeriodicInterval(_flushInterval);
+		_flushTimer.start(Poco::TimerCallback<SqlCharDataSource>(*this,&SqlCharDataSource::onFlushTimer));
+	}
+
+	//whatever the last run left in the money journal goes out before anything is loaded
+	flushMoney();
+}
+
+SqlCharDataSource::~SqlCharDataSource()
+{
+	//whatever is still pending goes out before the database does
+	_flushTimer.stop();
+	flushCharacters();
+	flushMoney();
+	flushLogins();
+
+	_logger.information("Character writes: " + _writtenHashes.stats());
+	_logger.information("Money: " + _ledger->stats());
+	if (_cache.enabled())
+		_logger.information("Character cache: " + _cache.stats());
+	if (_summaries.enabled())
+		_logger.information("Character lists: " + _summaries.stats());
+	if (_prefetch.enabled())
+		_logger.information("Login prefetch: " + _prefetch.stats());
 }
 
-SqlCharDataSource::~SqlCharDataSource() {}
+namespace
+{
+	//columns tracked by _writtenHashes
+	enum WrittenColumn
+	{
+		WRITTEN_WORLDSPACE,
+		WRITTEN_INVENTORY,
+		WRITTEN_BACKPACK,
+		WRITTEN_MEDICAL,
+		WRITTEN_CURRENTSTATE,
+		WRITTEN_NONE
+	};
+
+	WrittenColumn ArrayFieldColumn(CharDataSource::CharField field)
+	{
+		switch (field)
+		{
+		case CharDataSource::CHAR_WORLDSPACE: return WRITTEN_WORLDSPACE;
+		case CharDataSource::CHAR_INVENTORY: return WRITTEN_INVENTORY;
+		case CharDataSource::CHAR_BACKPACK: return WRITTEN_BACKPACK;
+		case CharDataSource::CHAR_MEDICAL: return WRITTEN_MEDICAL;
+		case CharDataSource::CHAR_CURRENTSTATE: return WRITTEN_CURRENTSTATE;
+		default: return WRITTEN_NONE;
+		}
+	}
+
+	//how each field of a character update gets written
+	enum FieldKind
+	{
+		KIND_ARRAY,		//serialized, skipped if it's the same as what was written last
+		KIND_TIMESTAMP,	//sets another column to the current time, no parameter
+		KIND_ADDITION,	//added to the column
+		KIND_STRING
+	};
+	struct FieldInfo
+	{
+		const char* column;
+		FieldKind kind;
+	};
+	//in CharField order, Worldspace column name is configurable
+	const FieldInfo CharFieldInfo[CharDataSource::NUM_CHAR_FIELDS] =
+	{
+		{ nullptr,			KIND_ARRAY },
+		{ "Inventory",		KIND_ARRAY },
+		{ "Backpack",		KIND_ARRAY },
+		{ "Medical",		KIND_ARRAY },
+		{ "LastAte",		KIND_TIMESTAMP },
+		{ "LastDrank",		KIND_TIMESTAMP },
+		{ "KillsZ",			KIND_ADDITION },
+		{ "HeadshotsZ",		KIND_ADDITION },
+		{ "DistanceFoot",	KIND_ADDITION },
+		{ "Duration",		KIND_ADDITION },
+		{ "CurrentState",	KIND_ARRAY },
+		{ "KillsH",			KIND_ADDITION },
+		{ "KillsB",			KIND_ADDITION },
+		{ "Model",			KIND_STRING },
+		{ "Humanity",		KIND_ADDITION },
+		{ "Money",			KIND_ADDITION }		//goes to the ledger instead
+	};
+
+	//Player_LOGIN action the scripts record when a player disconnects
+	const int LOGIN_ACTION_LOGOUT = 0;
+	//rows per Player_LOGIN insert, well under any max_allowed_packet
+	const size_t LOGIN_ROWS_PER_INSERT = 500;
+	//CharacterIDs per bulk detail query
+	const size_t DETAILS_IDS_PER_QUERY = 500;
+
+	void CacheArrayField(CharacterCache::Entry& cached, CharDataSource::CharField field, CharacterCache::ValuePtr val)
+	{
+		switch (field)
+		{
+		case CharDataSource::CHAR_WORLDSPACE: cached.worldSpace = std::move(val); break;
+		case CharDataSource::CHAR_INVENTORY: cached.inventory = std::move(val); break;
+		case CharDataSource::CHAR_BACKPACK: cached.backpack = std::move(val); break;
+		case CharDataSource::CHAR_MEDICAL: cached.details.medical = std::move(val); break;
+		case CharDataSource::CHAR_CURRENTSTATE: cached.details.currentState = std::move(val); break;
+		default: break;
+		}
+	}
+
+	void SummaryAddition(CharacterSummaries::Slot& summary, CharDataSource::CharField field, int addition)
+	{
+		switch (field)
+		{
+		case CharDataSource::CHAR_KILLSZ: summary.killsZ += addition; break;
+		case CharDataSource::CHAR_HEADSHOTSZ: summary.headshotsZ += addition; break;
+		case CharDataSource::CHAR_DISTANCEFOOT: summary.distanceFoot += addition; break;
+		case CharDataSource::CHAR_KILLSH: summary.killsH += addition; break;
+		case CharDataSource::CHAR_KILLSB: summary.killsB += addition; break;
+		case CharDataSource::CHAR_HUMANITY: summary.humanity += addition; break;
+		default: break;
+		}
+	}
+
+	void CacheAddition(CharacterCache::Details& details, CharDataSource::CharField field, int addition)
+	{
+		switch (field)
+		{
+		case CharDataSource::CHAR_KILLSZ: details.killsZ += addition; break;
+		case CharDataSource::CHAR_HEADSHOTSZ: details.headshotsZ += addition; break;
+		case CharDataSource::CHAR_KILLSH: details.killsH += addition; break;
+		case CharDataSource::CHAR_KILLSB: details.killsB += addition; break;
+		case CharDataSource::CHAR_HUMANITY: details.humanity += addition; break;
+		default: break;
+		}
+	}
+};
 
 Sqf::Value SqlCharDataSource::fetchCharacters( string playerId )
 {
-	//get characters from db (dead or alive)
-	auto charsRes = getDB()->queryParams(
-		("SELECT `CharacterID`, `Slot`, `" + _wsFieldName + "`, `Alive`, `Generation`, `Humanity`, `KillsZ`, `HeadshotsZ`, `KillsH`, `KillsB`, `DistanceFoot`, `Model`, `Infected`, "
-		"TIMESTAMPDIFF(MINUTE,`LastLogin`,NOW()) as `LastLoginDiff`, "
-		"TIMESTAMPDIFF(MINUTE,`Datestamp`,`LastLogin`) as `SurvivalTime` "
-		"FROM `Character_DATA` `cd1` "
-		"INNER JOIN (SELECT MAX(`CharacterID`) `MaxCharacterID` FROM `Character_DATA` WHERE `" + _idFieldName + "` = '%s' GROUP BY `Slot`) `cd2` "
-		"ON `cd1`.`CharacterID` = `cd2`.`MaxCharacterID` "
-		"ORDER BY `Slot`").c_str(), getDB()->escape(playerId).c_str());
-
-	/*
-	//get characters from db
-	auto charsRes = getDB()->queryParams(
-	("SELECT `CharacterID`, `Slot`, `"+_wsFieldName+"`, `Generation`, `Humanity`, `KillsZ`, `HeadshotsZ`, `KillsH`, `KillsB`, `DistanceFoot`, `Model`, `Infected`, "
-	"TIMESTAMPDIFF(MINUTE,`LastLogin`,NOW()) as `LastLoginDiff`, "
-	"TIMESTAMPDIFF(MINUTE,`Datestamp`,`LastLogin`) as `SurvivalTime` "
-	"FROM `Character_DATA` "
-	"WHERE `"+_idFieldName+"` = '%s' AND `Alive` = 1 "
-	"ORDER BY `Slot`").c_str(), getDB()->escape(playerId).c_str());
-	*/
+	CharacterSummaries::SlotMap loaded;
+	const CharacterSummaries::SlotMap* slots = _summaries.find(playerId);
+	if (_summaries.enabled())
+		_summaries.record(slots != nullptr);
 
-	Sqf::Parameters retVal;
-	Sqf::Parameters charsData;
-	if (charsRes) {
-		retVal.push_back(string("PASS"));
-		while (charsRes->fetchRow())
+	if (!slots)
+	{
+		//the list has to show what's still waiting to be written, which only this player's characters matter for
+		for (bool flushed = false;;)
 		{
-			int characterId = charsRes->at(0).getUInt32();
-			int slot = charsRes->at(1).getUInt8();
-			Sqf::Value worldSpace = Sqf::Parameters(); //empty worldspace
-			try
-			{
-				worldSpace = lexical_cast<Sqf::Value>(charsRes->at(2).getString());
-			}
-			catch (bad_lexical_cast)
+			//get characters from db (dead or alive)
+			auto charsRes = getDB()->queryParams(
+				("SELECT `CharacterID`, `Slot`, `" + _wsFieldName + "`, `Alive`, `Generation`, `Humanity`, `KillsZ`, `HeadshotsZ`, `KillsH`, `KillsB`, `DistanceFoot`, `Model`, `Infected`, "
+				"TIMESTAMPDIFF(MINUTE,`LastLogin`,NOW()) as `LastLoginDiff`, "
+				"TIMESTAMPDIFF(MINUTE,`Datestamp`,`LastLogin`) as `SurvivalTime` "
+				"FROM `Character_DATA` `cd1` "
+				"INNER JOIN (SELECT MAX(`CharacterID`) `MaxCharacterID` FROM `Character_DATA` WHERE `" + _idFieldName + "` = '%s' GROUP BY `Slot`) `cd2` "
+				"ON `cd1`.`CharacterID` = `cd2`.`MaxCharacterID` "
+				"ORDER BY `Slot`").c_str(), getDB()->escape(playerId).c_str());
+
+			/*
+			//get characters from db
+			auto charsRes = getDB()->queryParams(
+			("SELECT `CharacterID`, `Slot`, `"+_wsFieldName+"`, `Generation`, `Humanity`, `KillsZ`, `HeadshotsZ`, `KillsH`, `KillsB`, `DistanceFoot`, `Model`, `Infected`, "
+			"TIMESTAMPDIFF(MINUTE,`LastLogin`,NOW()) as `LastLoginDiff`, "
+			"TIMESTAMPDIFF(MINUTE,`Datestamp`,`LastLogin`) as `SurvivalTime` "
+			"FROM `Character_DATA` "
+			"WHERE `"+_idFieldName+"` = '%s' AND `Alive` = 1 "
+			"ORDER BY `Slot`").c_str(), getDB()->escape(playerId).c_str());
+			*/
+
+			if (!charsRes)
 			{
-				_logger.warning("Invalid Worldspace for CharacterID(" + lexical_cast<string>(characterId)+"): " + charsRes->at(2).getString());
+				Sqf::Parameters retVal;
+				retVal.push_back(string("ERROR"));
+				retVal.push_back(Sqf::Parameters());
+				//hive interface version
+				retVal.push_back(0.96f);
+				return retVal;
 			}
-			int alive = charsRes->at(3).getUInt8();
-			int generation = charsRes->at(4).getUInt32();
-			int humanity = charsRes->at(5).getInt32();
-			int killsZ = charsRes->at(6).getUInt32();
-			int headshotsZ = charsRes->at(7).getUInt32();
-			int killsH = charsRes->at(8).getUInt32();
-			int killsB = charsRes->at(9).getUInt32();
-			int distanceFoot = charsRes->at(10).getInt32();
-			string model = "";
-			try
+
+			loaded.clear();
+			while (charsRes->fetchRow())
 			{
-				model = boost::get<string>(lexical_cast<Sqf::Value>(charsRes->at(11).getString()));
+				CharacterSummaries::Slot summary;
+				summary.characterId = charsRes->at(0).getUInt32();
+				summary.slot = charsRes->at(1).getUInt8();
+				Sqf::Value worldSpace = Sqf::Parameters(); //empty worldspace
+				try
+				{
+					worldSpace = lexical_cast<Sqf::Value>(charsRes->at(2).getString());
+				}
+				catch (bad_lexical_cast)
+				{
+					_logger.warning("Invalid Worldspace for CharacterID(" + lexical_cast<string>(summary.characterId)+"): " + charsRes->at(2).getString());
+				}
+				summary.worldSpace = make_shared<Sqf::Value>(std::move(worldSpace));
+				summary.alive = (charsRes->at(3).getUInt8() != 0);
+				summary.generation = charsRes->at(4).getUInt32();
+				summary.humanity = charsRes->at(5).getInt32();
+				summary.killsZ = charsRes->at(6).getUInt32();
+				summary.headshotsZ = charsRes->at(7).getUInt32();
+				summary.killsH = charsRes->at(8).getUInt32();
+				summary.killsB = charsRes->at(9).getUInt32();
+				summary.distanceFoot = charsRes->at(10).getInt32();
+				try
+				{
+					summary.model = boost::get<string>(lexical_cast<Sqf::Value>(charsRes->at(11).getString()));
+				}
+				catch (...)
+				{
+					summary.model = charsRes->at(11).getString();
+				}
+				summary.infected = charsRes->at(12).getInt8();
+				summary.lastLogin = CharacterCache::MinutesAgo(charsRes->at(13).getInt32());
+				summary.aliveSince = summary.lastLogin - static_cast<Poco::Timestamp::TimeDiff>(charsRes->at(14).getInt32())*Poco::Timestamp::resolution()*60;
+
+				loaded[summary.slot] = std::move(summary);
 			}
-			catch (...)
+
+			if (flushed)
+				break;
+
+			//queried again once their held back updates are out, rare as it needs a relog
+			flushed = true;
+			bool anyPending = false;
+			for (auto it=loaded.cbegin(); it!=loaded.cend(); ++it)
 			{
-				model = charsRes->at(11).getString();
+				if (!hasPendingUpdate(it->second.characterId))
+					continue;
+
+				flushCharacter(it->second.characterId);
+				anyPending = true;
 			}
-			int infected = charsRes->at(12).getInt8();
-			int lastLoginDiff = charsRes->at(13).getInt32();
-			int survivalTime = charsRes->at(14).getInt32();
-
-			Sqf::Parameters stats;
-			stats.push_back(killsZ);
-			stats.push_back(headshotsZ);
-			stats.push_back(killsH);
-			stats.push_back(killsB);
-
-			Sqf::Parameters charData;
-			charData.push_back(lexical_cast<string>(characterId));
-			charData.push_back(slot);
-			charData.push_back(worldSpace);
-			charData.push_back(alive);
-			charData.push_back(generation);
-			charData.push_back(humanity);
-			charData.push_back(stats);
-			charData.push_back(distanceFoot);
-			charData.push_back(model);
-			charData.push_back(infected);
-			charData.push_back(lastLoginDiff);
-			charData.push_back(survivalTime);
-
-			charsData.push_back(charData);
+			if (!anyPending)
+				break;
 		}
+
+		slots = _summaries.set(playerId,loaded);
+		if (!slots)
+			slots = &loaded;
 	}
-	else
+
+	Sqf::Parameters charsData;
+	for (auto it=slots->cbegin(); it!=slots->cend(); ++it)
 	{
-		retVal.push_back(string("ERROR"));
+		const CharacterSummaries::Slot& summary = it->second;
+
+		//the client picks a slot next, get its 101 data ready before it asks
+		//not while its updates are still held back, the fetch wouldn't see them
+		if (summary.alive && _prefetch.enabled() && !_cache.findLive(playerId,summary.slot) && !hasPendingUpdate(summary.characterId))
+		{
+			Database* db = getDB();
+			string sql = loginSql(playerId,summary.slot);
+			_prefetch.start(playerId,summary.slot,summary.characterId,[db,sql]() -> unique_ptr<QueryResult>
+			{
+				db->threadEnter();
+				unique_ptr<QueryResult> res = db->query(sql.c_str());
+				db->threadExit();
+				return res;
+			});
+		}
+
+		Sqf::Parameters stats;
+		stats.push_back(summary.killsZ);
+		stats.push_back(summary.headshotsZ);
+		stats.push_back(summary.killsH);
+		stats.push_back(summary.killsB);
+
+		Sqf::Parameters charData;
+		charData.push_back(lexical_cast<string>(summary.characterId));
+		charData.push_back(summary.slot);
+		charData.push_back(*summary.worldSpace);
+		charData.push_back(summary.alive ? 1 : 0);
+		charData.push_back(summary.generation);
+		charData.push_back(summary.humanity);
+		charData.push_back(stats);
+		charData.push_back(summary.distanceFoot);
+		charData.push_back(summary.model);
+		charData.push_back(summary.infected);
+		charData.push_back(CharacterCache::MinutesSince(summary.lastLogin));
+		charData.push_back(static_cast<int>((summary.lastLogin - summary.aliveSince) / (Poco::Timestamp::resolution()*60)));
+
+		charsData.push_back(charData);
 	}
 
+	Sqf::Parameters retVal;
+	retVal.push_back(string("PASS"));
 	retVal.push_back(charsData);
 	//hive interface version
 	retVal.push_back(0.96f);
@@ -127,46 +326,132 @@ Sqf::Value SqlCharDataSource::fetchCharacters( string playerId )
 	return retVal;
 }
 
+void SqlCharDataSource::changePlayerName( const string& playerId, const string& oldName, const string& newName )
+{
+	auto stmt = getDB()->makeStatement(_stmtChangePlayerName, "UPDATE `Player_DATA` SET `PlayerName`=? WHERE `" + _idFieldName + "`=?");
+	stmt->addString(newName);
+	stmt->addString(playerId);
+	bool exRes = stmt->execute();
+	poco_assert(exRes == true);
+	_logger.information("Changed name of player " + playerId + " from '" + oldName + "' to '" + newName + "'");
+}
+
+void SqlCharDataSource::updateLastLogin( int characterId )
+{
+	auto stmt = getDB()->makeStatement(_stmtUpdateCharacterLastLogin, "UPDATE `Character_DATA` SET `LastLogin` = CURRENT_TIMESTAMP WHERE `CharacterID` = ?");
+	stmt->addInt32(characterId);
+	bool exRes = stmt->execute();
+	poco_assert(exRes == true);
+
+	if (CharacterSummaries::Slot* summary = _summaries.findCharacter(characterId))
+		summary->lastLogin.update();
+}
+
+Sqf::Value SqlCharDataSource::cachedCharacterInitial( CharacterCache::Entry& cached, const string& playerName )
+{
+	//the name change and the login go out together
+	UnitOfWork work(*getDB());
+	if (cached.playerName != playerName)
+	{
+		changePlayerName(cached.playerId,cached.playerName,playerName);
+		cached.playerName = playerName;
+	}
+
+	//survival time is counted up to the previous login, like the query does
+	Sqf::Parameters survival;
+	survival.push_back(static_cast<int>((cached.lastLogin - cached.aliveSince) / (Poco::Timestamp::resolution()*60)));
+	survival.push_back(CharacterCache::MinutesSince(cached.lastAte));
+	survival.push_back(CharacterCache::MinutesSince(cached.lastDrank));
+
+	cached.lastLogin.update();
+	updateLastLogin(cached.characterId);
+
+	Sqf::Value inventory = *cached.inventory;
+	try { SanitiseInv(boost::get<Sqf::Parameters>(inventory)); }
+	catch (const boost::bad_get&) {}
+
+	Sqf::Parameters retVal;
+	retVal.push_back(string("PASS"));
+	retVal.push_back(false);
+	retVal.push_back(lexical_cast<string>(cached.characterId));
+	retVal.push_back(*cached.worldSpace);
+	retVal.push_back(std::move(inventory));
+	retVal.push_back(*cached.backpack);
+	retVal.push_back(std::move(survival));
+	retVal.push_back(cached.model);
+	//hive interface version
+	retVal.push_back(0.96f);
+
+	return retVal;
+}
+
+string SqlCharDataSource::loginSql( const string& playerId, int characterSlot ) const
+{
+	//the player, the alive character in the slot, and the dead one before it (for a new character) all come in one query
+	string escapedId = getDB()->escape(playerId);
+	string slotStr = lexical_cast<string>(characterSlot);
+	return "SELECT `p`.`" + _idFieldName + "`, `p`.`PlayerName`, "
+		"`c`.`CharacterID`, `c`.`" + _wsFieldName + "`, `c`.`Inventory`, `c`.`Backpack`, "
+		"TIMESTAMPDIFF(MINUTE,`c`.`Datestamp`,`c`.`LastLogin`) as `SurvivalTime`, "
+		"TIMESTAMPDIFF(MINUTE,`c`.`LastAte`,NOW()) as `MinsLastAte`, "
+		"TIMESTAMPDIFF(MINUTE,`c`.`LastDrank`,NOW()) as `MinsLastDrank`, "
+		"`c`.`Model`, TIMESTAMPDIFF(MINUTE,`c`.`Datestamp`,NOW()) as `MinsAlive`, "
+		//the same as 102 loads, so that can come from the cache
+		"`c`.`Medical`, `c`.`Generation`, `c`.`KillsZ`, `c`.`HeadshotsZ`, `c`.`KillsH`, `c`.`KillsB`, `c`.`CurrentState`, `c`.`Humanity`, `c`.`InstanceID`, `c`.`Money`, "
+		"`d`.`Generation`, `d`.`Humanity`, `d`.`Model`, `d`.`Infected` "
+		"FROM (SELECT 1) `login` "
+		"LEFT JOIN `Player_DATA` `p` ON `p`.`" + _idFieldName + "` = '" + escapedId + "' "
+		"LEFT JOIN `Character_DATA` `c` ON `c`.`CharacterID` = "
+			"(SELECT MAX(`CharacterID`) FROM `Character_DATA` WHERE `" + _idFieldName + "` = '" + escapedId + "' AND `Slot` = " + slotStr + " AND `Alive` = 1) "
+		"LEFT JOIN `Character_DATA` `d` ON `c`.`CharacterID` IS NULL AND `d`.`CharacterID` = "
+			"(SELECT MAX(`CharacterID`) FROM `Character_DATA` WHERE `" + _idFieldName + "` = '" + escapedId + "' AND `Slot` = " + slotStr + " AND `Alive` = 0) "
+		"LIMIT 1";
+}
+
 Sqf::Value SqlCharDataSource::fetchCharacterInitial( string playerId, int serverId, const string& playerName, int characterSlot )
 {
-	bool newPlayer = false;
-	//make sure player exists in db
+	//character already in play, everything needed is in memory
 	{
-		auto playerRes(getDB()->queryParams(("SELECT `PlayerName`, `PlayerSex` FROM `Player_DATA` WHERE `" + _idFieldName + "`='%s'").c_str(), getDB()->escape(playerId).c_str()));
-		if (playerRes && playerRes->fetchRow())
-		{
-			newPlayer = false;
-			//update player name if not current
-			if (playerRes->at(0).getString() != playerName)
-			{
-				auto stmt = getDB()->makeStatement(_stmtChangePlayerName, "UPDATE `Player_DATA` SET `PlayerName`=? WHERE `" + _idFieldName + "`=?");
-				stmt->addString(playerName);
-				stmt->addString(playerId);
-				bool exRes = stmt->execute();
-				poco_assert(exRes == true);
-				_logger.information("Changed name of player " + playerId + " from '" + playerRes->at(0).getString() + "' to '" + playerName + "'");
-			}
-		}
-		else
-		{
-			newPlayer = true;
-			//insert new player into db
-			auto stmt = getDB()->makeStatement(_stmtInsertPlayer, "INSERT INTO `Player_DATA` (`" + _idFieldName + "`, `PlayerName`) VALUES (?, ?)");
-			stmt->addString(playerId);
-			stmt->addString(playerName);
-			bool exRes = stmt->execute();
-			poco_assert(exRes == true);
-			_logger.information("Created a new player " + playerId + " named '" + playerName + "'");
-		}
+		CharacterCache::Entry* cached = _cache.findLive(playerId,characterSlot);
+		if (_cache.enabled())
+			_cache.record(cached != nullptr);
+		if (cached)
+			return cachedCharacterInitial(*cached,playerName);
+	}
+
+	//usually already fetched in the background after 100
+	unique_ptr<QueryResult> charsRes = _prefetch.take(playerId,characterSlot);
+	if (!charsRes)
+		charsRes = getDB()->query(loginSql(playerId,characterSlot).c_str());
+	if (!charsRes || !charsRes->fetchRow())
+	{
+		_logger.error("Error fetching login data for playerId " + playerId);
+		Sqf::Parameters retVal;
+		retVal.push_back(string("ERROR"));
+		return retVal;
+	}
+
+	//the player write and the login of the existing character go out together
+	UnitOfWork work(*getDB());
+	//make sure player exists in db, the writes don't need to be waited for
+	bool newPlayer = charsRes->at(0).isNull();
+	if (!newPlayer)
+	{
+		//update player name if not current
+		if (charsRes->at(1).getString() != playerName)
+			changePlayerName(playerId,charsRes->at(1).getString(),playerName);
+	}
+	else
+	{
+		//insert new player into db
+		auto stmt = getDB()->makeStatement(_stmtInsertPlayer, "INSERT INTO `Player_DATA` (`" + _idFieldName + "`, `PlayerName`) VALUES (?, ?)");
+		stmt->addString(playerId);
+		stmt->addString(playerName);
+		bool exRes = stmt->execute();
+		poco_assert(exRes == true);
+		_logger.information("Created a new player " + playerId + " named '" + playerName + "'");
 	}
 
-	//get characters from db
-	auto charsRes = getDB()->queryParams(
-		("SELECT `CharacterID`, `" + _wsFieldName + "`, `Inventory`, `Backpack`, "
-		"TIMESTAMPDIFF(MINUTE,`Datestamp`,`LastLogin`) as `SurvivalTime`, "
-		"TIMESTAMPDIFF(MINUTE,`LastAte`,NOW()) as `MinsLastAte`, "
-		"TIMESTAMPDIFF(MINUTE,`LastDrank`,NOW()) as `MinsLastDrank`, "
-		"`Model` FROM `Character_DATA` WHERE `" + _idFieldName + "` = '%s' AND `Slot` = %d AND `Alive` = 1 ORDER BY `CharacterID` DESC LIMIT 1").c_str(), getDB()->escape(playerId).c_str(), characterSlot);
 	int infected = 0;
 	bool newChar = false; //not a new char
 	int characterId = -1; //invalid charid
@@ -175,66 +460,78 @@ Sqf::Value SqlCharDataSource::fetchCharacterInitial( string playerId, int server
 	Sqf::Value backpack = lexical_cast<Sqf::Value>("[]"); //empty backpack
 	Sqf::Value survival = lexical_cast<Sqf::Value>("[0,0,0]"); //0 mins alive, 0 mins since last ate, 0 mins since last drank
 	string model = ""; //empty models will be defaulted by scripts
-	if (charsRes && charsRes->fetchRow())
+	if (!charsRes->at(2).isNull())
 	{
 		newChar = false;
-		characterId = charsRes->at(0).getInt32();
+		characterId = charsRes->at(2).getInt32();
+		//might have been played on another server since we last wrote it
+		_writtenHashes.forget(characterId);
 		try
 		{
-			worldSpace = lexical_cast<Sqf::Value>(charsRes->at(1).getString());
+			worldSpace = lexical_cast<Sqf::Value>(charsRes->at(3).getString());
 		}
 		catch (bad_lexical_cast)
 		{
-			_logger.warning("Invalid Worldspace for CharacterID(" + lexical_cast<string>(characterId)+"): " + charsRes->at(1).getString());
+			_logger.warning("Invalid Worldspace for CharacterID(" + lexical_cast<string>(characterId)+"): " + charsRes->at(3).getString());
 		}
-		if (!charsRes->at(2).isNull()) //inventory can be null
+		if (!charsRes->at(4).isNull()) //inventory can be null
 		{
 			try
 			{
-				inventory = lexical_cast<Sqf::Value>(charsRes->at(2).getString());
+				inventory = lexical_cast<Sqf::Value>(charsRes->at(4).getString());
 				try { SanitiseInv(boost::get<Sqf::Parameters>(inventory)); }
 				catch (const boost::bad_get&) {}
 			}
 			catch (bad_lexical_cast)
 			{
-				_logger.warning("Invalid Inventory for CharacterID(" + lexical_cast<string>(characterId)+"): " + charsRes->at(2).getString());
+				_logger.warning("Invalid Inventory for CharacterID(" + lexical_cast<string>(characterId)+"): " + charsRes->at(4).getString());
 			}
 		}
-		if (!charsRes->at(3).isNull()) //backpack can be null
+		if (!charsRes->at(5).isNull()) //backpack can be null
 		{
 			try
 			{
-				backpack = lexical_cast<Sqf::Value>(charsRes->at(3).getString());
+				backpack = lexical_cast<Sqf::Value>(charsRes->at(5).getString());
 			}
 			catch (bad_lexical_cast)
 			{
-				_logger.warning("Invalid Backpack for CharacterID(" + lexical_cast<string>(characterId)+"): " + charsRes->at(3).getString());
+				_logger.warning("Invalid Backpack for CharacterID(" + lexical_cast<string>(characterId)+"): " + charsRes->at(5).getString());
 			}
 		}
 		//set survival info
 		{
 			Sqf::Parameters& survivalArr = boost::get<Sqf::Parameters>(survival);
-			survivalArr[0] = charsRes->at(4).getInt32();
-			survivalArr[1] = charsRes->at(5).getInt32();
-			survivalArr[2] = charsRes->at(6).getInt32();
+			survivalArr[0] = charsRes->at(6).getInt32();
+			survivalArr[1] = charsRes->at(7).getInt32();
+			survivalArr[2] = charsRes->at(8).getInt32();
 		}
 		try
 		{
-			model = boost::get<string>(lexical_cast<Sqf::Value>(charsRes->at(7).getString()));
+			model = boost::get<string>(lexical_cast<Sqf::Value>(charsRes->at(9).getString()));
 		}
 		catch (...)
 		{
-			model = charsRes->at(7).getString();
+			model = charsRes->at(9).getString();
 		}
 
-		//update last login
+		if (CharacterCache::Entry* cached = _cache.insert(characterId,playerId,characterSlot))
 		{
-			//update last character login
-			auto stmt = getDB()->makeStatement(_stmtUpdateCharacterLastLogin, "UPDATE `Character_DATA` SET `LastLogin` = CURRENT_TIMESTAMP WHERE `CharacterID` = ?");
-			stmt->addInt32(characterId);
-			bool exRes = stmt->execute();
-			poco_assert(exRes == true);
+			cached->playerName = playerName;
+			cached->worldSpace = make_shared<Sqf::Value>(worldSpace);
+			cached->inventory = make_shared<Sqf::Value>(inventory);
+			cached->backpack = make_shared<Sqf::Value>(backpack);
+			cached->model = model;
+
+			const Sqf::Parameters& survivalArr = boost::get<Sqf::Parameters>(survival);
+			cached->aliveSince = CharacterCache::MinutesAgo(charsRes->at(10).getInt32());
+			cached->lastAte = CharacterCache::MinutesAgo(boost::get<int>(survivalArr[1]));
+			cached->lastDrank = CharacterCache::MinutesAgo(boost::get<int>(survivalArr[2]));
+
+			readDetails(*charsRes,11,cached->details,characterId);
+			cached->hasDetails = true;
 		}
+
+		updateLastLogin(characterId);
 	}
 	else //inserting new character
 	{
@@ -242,29 +539,24 @@ Sqf::Value SqlCharDataSource::fetchCharacterInitial( string playerId, int server
 
 		int generation = 1;
 		int humanity = 2500;
-		//try getting previous character info
+		//previous character info
+		if (!charsRes->at(21).isNull())
 		{
-			auto prevCharRes = getDB()->queryParams(
-				("SELECT `Generation`, `Humanity`, `Model`, `Infected` FROM `Character_DATA` WHERE `" + _idFieldName + "` = '%s' AND `Slot` = %d AND `Alive` = 0 ORDER BY `CharacterID` DESC LIMIT 1").c_str(), getDB()->escape(playerId).c_str(), characterSlot);
-			if (prevCharRes && prevCharRes->fetchRow())
-			{
-				generation = prevCharRes->at(0).getInt32();
-				generation++; //apparently this was the correct behaviour all along
-
-				humanity = prevCharRes->at(1).getInt32();
-				try
-				{
-					model = boost::get<string>(lexical_cast<Sqf::Value>(prevCharRes->at(2).getString()));
-				}
-				catch (...)
-				{
-					model = prevCharRes->at(2).getString();
-				}
-				infected = prevCharRes->at(3).getInt32();
-
+			generation = charsRes->at(21).getInt32();
+			generation++; //apparently this was the correct behaviour all along
 
+			humanity = charsRes->at(22).getInt32();
+			try
+			{
+				model = boost::get<string>(lexical_cast<Sqf::Value>(charsRes->at(23).getString()));
+			}
+			catch (...)
+			{
+				model = charsRes->at(23).getString();
 			}
+			infected = charsRes->at(24).getInt32();
 		}
+
 		Sqf::Value medical = Sqf::Parameters(); //script will fill this in if empty
 		//insert new char into db
 		{
@@ -303,6 +595,24 @@ Sqf::Value SqlCharDataSource::fetchCharacterInitial( string playerId, int server
 			characterId = newCharRes->at(0).getInt32();
 		}
 		_logger.information("Created a new character " + lexical_cast<string>(characterId)+" for player '" + playerName + "' (" + playerId + ")");
+
+		if (CharacterSummaries::Slot* summary = _summaries.replaceSlot(playerId,characterSlot,characterId))
+		{
+			summary->worldSpace = make_shared<Sqf::Value>(worldSpace);
+			summary->generation = generation;
+			summary->humanity = humanity;
+			summary->model = model;
+		}
+
+		//the details are left for 102 to load, the other columns have defaults
+		if (CharacterCache::Entry* cached = _cache.insert(characterId,playerId,characterSlot))
+		{
+			cached->playerName = playerName;
+			cached->worldSpace = make_shared<Sqf::Value>(worldSpace);
+			cached->inventory = make_shared<Sqf::Value>(inventory);
+			cached->backpack = make_shared<Sqf::Value>(backpack);
+			cached->model = model;
+		}
 	}
 
 	Sqf::Parameters retVal;
@@ -327,163 +637,550 @@ Sqf::Value SqlCharDataSource::fetchCharacterInitial( string playerId, int server
 	return retVal;
 }
 
-Sqf::Value SqlCharDataSource::fetchCharacterDetails( int characterId )
+void SqlCharDataSource::readDetails( const QueryResult& res, size_t firstCol, CharacterCache::Details& details, int characterId )
 {
+	details.medical = make_shared<Sqf::Value>(Sqf::Parameters()); //script will fill this in if empty
+	details.currentState = make_shared<Sqf::Value>(Sqf::Parameters()); //empty state (aiming, etc)
+
+	try
+	{
+		details.medical = make_shared<Sqf::Value>(lexical_cast<Sqf::Value>(res.at(firstCol+0).getString()));
+	}
+	catch(bad_lexical_cast)
+	{
+		_logger.warning("Invalid Medical (detail load) for CharacterID("+lexical_cast<string>(characterId)+"): "+res.at(firstCol+0).getString());
+	}
+	details.generation = res.at(firstCol+1).getInt32();
+	details.killsZ = res.at(firstCol+2).getInt32();
+	details.headshotsZ = res.at(firstCol+3).getInt32();
+	details.killsH = res.at(firstCol+4).getInt32();
+	details.killsB = res.at(firstCol+5).getInt32();
+	try
+	{
+		details.currentState = make_shared<Sqf::Value>(lexical_cast<Sqf::Value>(res.at(firstCol+6).getString()));
+	}
+	catch(bad_lexical_cast)
+	{
+		_logger.warning("Invalid CurrentState (detail load) for CharacterID("+lexical_cast<string>(characterId)+"): "+res.at(firstCol+6).getString());
+	}
+	details.humanity = res.at(firstCol+7).getInt32();
+	details.instance = res.at(firstCol+8).getInt32();
+	//the deltas the ledger hasn't written yet aren't in there
+	details.money = res.at(firstCol+9).getInt32() + _ledger->unwritten(CurrencyLedger::ACCOUNT_CHARACTER,characterId);
+}
+
+Sqf::Value SqlCharDataSource::DetailsResult( const CharacterCache::Details& details, const Sqf::Value& worldSpace )
+{
+	Sqf::Parameters stats; //killsZ, headZ, killsH, killsB
+	stats.push_back(details.killsZ);
+	stats.push_back(details.headshotsZ);
+	stats.push_back(details.killsH);
+	stats.push_back(details.killsB);
+
 	Sqf::Parameters retVal;
+	retVal.push_back(string("PASS"));
+	retVal.push_back(*details.medical);
+	retVal.push_back(std::move(stats));
+	retVal.push_back(*details.currentState);
+	retVal.push_back(worldSpace);
+	retVal.push_back(details.humanity);
+	retVal.push_back(details.instance);
+	retVal.push_back(details.money);
+	return retVal;
+}
+
+Sqf::Value SqlCharDataSource::fetchCharacterDetails( int characterId )
+{
+	CharacterCache::Entry* cached = _cache.find(characterId);
+	if (_cache.enabled())
+		_cache.record(cached != nullptr && cached->hasDetails);
+	if (cached && cached->hasDetails)
+		return DetailsResult(cached->details,*cached->worldSpace);
+
+	//so the counters read back include what hasn't been flushed yet
+	flushCharacter(characterId);
+
 	//get details from db
 	auto charDetRes = getDB()->queryParams(
-		"SELECT `%s`, `Medical`, `Generation`, `KillsZ`, `HeadshotsZ`, `KillsH`, `KillsB`, `CurrentState`, `Humanity`, `InstanceID`, `Money` "
+		"SELECT `Medical`, `Generation`, `KillsZ`, `HeadshotsZ`, `KillsH`, `KillsB`, `CurrentState`, `Humanity`, `InstanceID`, `Money`, `%s` "
 		"FROM `Character_DATA` WHERE `CharacterID`=%d", _wsFieldName.c_str(), characterId);
 
 	if (charDetRes && charDetRes->fetchRow())
 	{
+		_writtenHashes.forget(characterId);
+
 		Sqf::Value worldSpace = Sqf::Parameters(); //empty worldspace
-		Sqf::Value medical = Sqf::Parameters(); //script will fill this in if empty
-		int generation = 1;
-		Sqf::Value stats = lexical_cast<Sqf::Value>("[0,0,0,0]"); //killsZ, headZ, killsH, killsB
-		Sqf::Value currentState = Sqf::Parameters(); //empty state (aiming, etc)
-		int money = 0;
-		int humanity = 2500;
-		int instance = 1;
-		//get stuff from row
+		try
 		{
+			worldSpace = lexical_cast<Sqf::Value>(charDetRes->at(10).getString());
+		}
+		catch(bad_lexical_cast)
+		{
+			_logger.warning("Invalid Worldspace (detail load) for CharacterID("+lexical_cast<string>(characterId)+"): "+charDetRes->at(10).getString());
+		}
+
+		CharacterCache::Details details;
+		readDetails(*charDetRes,0,details,characterId);
+		if (cached)
+		{
+			cached->details = details;
+			cached->hasDetails = true;
+		}
+
+		return DetailsResult(details,worldSpace);
+	}
+
+	Sqf::Parameters retVal;
+	retVal.push_back(string("ERROR"));
+	return retVal;
+}
+
+void SqlCharDataSource::fetchCharacterDetailsBulk( const vector<int>& characterIds, DetailsQueue& outDetails )
+{
+	map<int,Sqf::Value> results;
+	std::set<int> requested;
+	vector<int> toLoad;
+	for (auto it=characterIds.cbegin(); it!=characterIds.cend(); ++it)
+	{
+		if (!requested.insert(*it).second)
+			continue;
+
+		CharacterCache::Entry* cached = _cache.find(*it);
+		if (_cache.enabled())
+			_cache.record(cached != nullptr && cached->hasDetails);
+		if (cached && cached->hasDetails)
+		{
+			results[*it] = DetailsResult(cached->details,*cached->worldSpace);
+			continue;
+		}
+
+		//so the counters read back include what hasn't been flushed yet
+		flushCharacter(*it);
+		toLoad.push_back(*it);
+	}
+
+	//all the ones not in memory come in one query (a few for a lot of them)
+	for (size_t first=0; first<toLoad.size(); first+=DETAILS_IDS_PER_QUERY)
+	{
+		size_t end = first + DETAILS_IDS_PER_QUERY;
+		if (end > toLoad.size())
+			end = toLoad.size();
+
+		string idList;
+		for (size_t i=first; i<end; i++)
+		{
+			if (i > first)
+				idList += ",";
+			idList += lexical_cast<string>(toLoad[i]);
+		}
+
+		auto charDetRes = getDB()->query(("SELECT `CharacterID`, `Medical`, `Generation`, `KillsZ`, `HeadshotsZ`, `KillsH`, `KillsB`, `CurrentState`, `Humanity`, `InstanceID`, `Money`, `" + _wsFieldName + "` "
+			"FROM `Character_DATA` WHERE `CharacterID` IN (" + idList + ")").c_str());
+		if (!charDetRes)
+			continue;
+
+		while (charDetRes->fetchRow())
+		{
+			int characterId = charDetRes->at(0).getInt32();
+			_writtenHashes.forget(characterId);
+
+			Sqf::Value worldSpace = Sqf::Parameters(); //empty worldspace
 			try
 			{
-				worldSpace = lexical_cast<Sqf::Value>(charDetRes->at(0).getString());
-			}
-			catch(bad_lexical_cast)
-			{
-				_logger.warning("Invalid Worldspace (detail load) for CharacterID("+lexical_cast<string>(characterId)+"): "+charDetRes->at(0).getString());
-			}
-			try
-			{
-				medical = lexical_cast<Sqf::Value>(charDetRes->at(1).getString());
+				worldSpace = lexical_cast<Sqf::Value>(charDetRes->at(11).getString());
 			}
 			catch(bad_lexical_cast)
 			{
-				_logger.warning("Invalid Medical (detail load) for CharacterID("+lexical_cast<string>(characterId)+"): "+charDetRes->at(1).getString());
+				_logger.warning("Invalid Worldspace (detail load) for CharacterID("+lexical_cast<string>(characterId)+"): "+charDetRes->at(11).getString());
 			}
-			generation = charDetRes->at(2).getInt32();
-			//set stats
-			{
-				Sqf::Parameters& statsArr = boost::get<Sqf::Parameters>(stats);
-				statsArr[0] = charDetRes->at(3).getInt32();
-				statsArr[1] = charDetRes->at(4).getInt32();
-				statsArr[2] = charDetRes->at(5).getInt32();
-				statsArr[3] = charDetRes->at(6).getInt32();
-			}
-			try
-			{
-				currentState = lexical_cast<Sqf::Value>(charDetRes->at(7).getString());
-			}
-			catch(bad_lexical_cast)
+
+			CharacterCache::Details details;
+			readDetails(*charDetRes,1,details,characterId);
+			if (CharacterCache::Entry* cached = _cache.find(characterId))
 			{
-				_logger.warning("Invalid CurrentState (detail load) for CharacterID("+lexical_cast<string>(characterId)+"): "+charDetRes->at(7).getString());
+				cached->details = details;
+				cached->hasDetails = true;
 			}
-			humanity = charDetRes->at(8).getInt32();
-			instance = charDetRes->at(9).getInt32();
-			money = charDetRes->at(10).getInt32();
+
+			results[characterId] = DetailsResult(details,worldSpace);
 		}
+	}
 
-		retVal.push_back(string("PASS"));
-		retVal.push_back(medical);
-		retVal.push_back(stats);
-		retVal.push_back(currentState);
-		retVal.push_back(worldSpace);
-		retVal.push_back(humanity);
-		retVal.push_back(instance);
-		retVal.push_back(money);
+	for (auto it=characterIds.cbegin(); it!=characterIds.cend(); ++it)
+	{
+		Sqf::Parameters entry;
+		entry.push_back(lexical_cast<string>(*it));
+		auto resIt = results.find(*it);
+		if (resIt == results.end())
+		{
+			Sqf::Parameters errorRes;
+			errorRes.push_back(string("ERROR"));
+			entry.push_back(std::move(errorRes));
+		}
+		else
+			entry.push_back(resIt->second);
+
+		outDetails.push_back(std::move(entry));
 	}
-	else
+}
+
+const string& SqlCharDataSource::updateCharacterSql( UInt32 mask )
+{
+	auto it = _updateCharacterSql.find(mask);
+	if (it != _updateCharacterSql.end())
+		return it->second;
+
+	string query = "UPDATE `Character_DATA` SET ";
+	for (int i=0; i<NUM_CHAR_FIELDS; i++)
 	{
-		retVal.push_back(string("ERROR"));
+		if ((mask & (1u << i)) == 0)
+			continue;
+
+		const FieldInfo& info = CharFieldInfo[i];
+		string column = (i == CHAR_WORLDSPACE) ? _wsFieldName : string(info.column);
+		if (info.kind == KIND_TIMESTAMP)
+			query += "`" + column + "` = DATE_SUB(CURRENT_TIMESTAMP, INTERVAL ? SECOND), ";
+		else if (info.kind == KIND_ADDITION)
+			query += "`" + column + "` = `" + column + "` + ?, ";
+		else
+			query += "`" + column + "` = ?, ";
 	}
+	query += "`InstanceID` = ? WHERE `CharacterID` = ?";
 
-	return retVal;
+	return _updateCharacterSql[mask] = std::move(query);
 }
 
-bool SqlCharDataSource::updateCharacter( int characterId, int serverId, const FieldsType& fields )
+void SqlCharDataSource::PendingUpdate::merge( PendingUpdate& newer )
 {
-	map<string,string> sqlFields;
+	for (int i=0; i<NUM_CHAR_FIELDS; i++)
+	{
+		if ((newer.mask & (1u << i)) == 0)
+			continue;
 
-	for (auto it=fields.begin();it!=fields.end();++it)
+		switch (CharFieldInfo[i].kind)
+		{
+		case KIND_ARRAY:
+			arrays[i] = std::move(newer.arrays[i]);
+			break;
+		case KIND_TIMESTAMP:
+			stamps[i] = newer.stamps[i];
+			break;
+		case KIND_ADDITION:
+			additions[i] += newer.additions[i];
+			break;
+		case KIND_STRING:
+			model = std::move(newer.model);
+			break;
+		}
+	}
+	serverId = newer.serverId;
+	mask |= newer.mask;
+}
+
+bool SqlCharDataSource::updateCharacter( int characterId, int serverId, FieldsType fields )
+{
+	_prefetch.invalidate(characterId);
+
+	//the cached state gets the changes right away, the database when they're flushed
+	CharacterCache::Entry* cached = _cache.find(characterId);
+	if (cached && cached->hasDetails)
+		cached->details.instance = serverId;
+	CharacterSummaries::Slot* summary = _summaries.findCharacter(characterId);
+
+	PendingUpdate update;
+	update.serverId = serverId;
+	for (int i=0; i<NUM_CHAR_FIELDS; i++)
 	{
-		const string& name = it->first;
-		const Sqf::Value& val = it->second;
+		CharField field = static_cast<CharField>(i);
+		if (!fields.has(field))
+			continue;
 
-		//arrays
-		if (name == "Worldspace" || name == "Inventory" || name == "Backpack" || name == "Medical" || name == "CurrentState")
-			sqlFields[name] = "'"+getDB()->escape(lexical_cast<string>(val))+"'";
-		//booleans
-		else if (name == "JustAte" || name == "JustDrank")
+		Sqf::Value& val = fields.values[i];
+		switch (CharFieldInfo[i].kind)
 		{
-			if (boost::get<bool>(val))
+		case KIND_ARRAY:
+			update.arrays[i] = make_shared<Sqf::Value>(std::move(val));
+			if (cached)
+				CacheArrayField(*cached,field,update.arrays[i]);
+			if (summary && field == CHAR_WORLDSPACE)
+				summary->worldSpace = update.arrays[i];
+			break;
+		case KIND_TIMESTAMP:
+			if (!boost::get<bool>(val))
+				continue;
+			update.stamps[i].update();
+			if (cached)
 			{
-				string newName = "LastAte";
-				if (name == "JustDrank")
-					newName = "LastDrank";
-
-				sqlFields[newName] = "CURRENT_TIMESTAMP";
+				if (field == CHAR_JUSTATE)
+					cached->lastAte.update();
+				else
+					cached->lastDrank.update();
 			}
-		}
-		//addition integeroids
-		else if (name == "KillsZ" || name == "HeadshotsZ" || name == "DistanceFoot" || name == "Duration" ||
-			name == "KillsH" || name == "KillsB" || name == "Humanity" || name == "Money")
-		{
-			int integeroid = static_cast<int>(Sqf::GetDouble(val));
-			char intSign = '+';
-			if (integeroid < 0)
+			break;
+		case KIND_ADDITION:
+			update.additions[i] = static_cast<int>(Sqf::GetDouble(val));
+			if (update.additions[i] == 0)
+				continue;
+			if (field == CHAR_MONEY)
 			{
-				intSign = '-';
-				integeroid = abs(integeroid);
+				//not journalled means it has to go out now
+				if (!_ledger->add(CurrencyLedger::ACCOUNT_CHARACTER,characterId,update.additions[i]) || _flushInterval <= 0)
+					flushMoney(characterId);
+				if (cached && cached->hasDetails)
+					cached->details.money += update.additions[i];
+				continue;
 			}
+			if (cached && cached->hasDetails)
+				CacheAddition(cached->details,field,update.additions[i]);
+			if (summary)
+				SummaryAddition(*summary,field,update.additions[i]);
+			break;
+		case KIND_STRING:
+			update.model = boost::get<string>(val);
+			if (cached)
+				cached->model = update.model;
+			if (summary)
+				summary->model = update.model;
+			break;
+		}
+		update.mask |= (1u << i);
+	}
+
+	if (update.mask == 0)
+		return true;
+
+	if (_flushInterval <= 0)
+		return writeCharacter(characterId,update);
+
+	//the counters are deltas, held in memory they'd be lost for good in a crash, so they go out now
+	PendingUpdate counters;
+	counters.serverId = serverId;
+	for (int i=0; i<NUM_CHAR_FIELDS; i++)
+	{
+		UInt32 bit = (1u << i);
+		if ((update.mask & bit) == 0 || CharFieldInfo[i].kind != KIND_ADDITION)
+			continue;
+
+		counters.additions[i] = update.additions[i];
+		counters.mask |= bit;
+		update.additions[i] = 0;
+		update.mask &= ~bit;
+	}
+
+	bool exRes = true;
+	if (counters.mask != 0)
+		exRes = writeCharacter(characterId,counters);
+
+	//the rest only keeps the latest value, which is held until the next flush
+	if (update.mask != 0)
+	{
+		Poco::ScopedLock<Poco::FastMutex> guard(_pendingLock);
+		_pendingUpdates[characterId].merge(update);
+	}
+
+	return exRes;
+}
+
+bool SqlCharDataSource::writeCharacter( int characterId, const PendingUpdate& update )
+{
+	//work out which fields actually change anything
+	UInt32 mask = 0;
+	for (int i=0; i<NUM_CHAR_FIELDS; i++)
+	{
+		UInt32 bit = (1u << i);
+		if ((update.mask & bit) == 0)
+			continue;
 
-			if (integeroid > 0) 
-				sqlFields[name] = "(`"+name+"` "+intSign+" "+lexical_cast<string>(integeroid)+")";
+		if (CharFieldInfo[i].kind == KIND_ARRAY)
+		{
+			if (!_writtenHashes.changed(characterId,ArrayFieldColumn(static_cast<CharField>(i)),PersistedHashes::Hash(*update.arrays[i])))
+				continue;
 		}
-		//strings
-		else if (name == "Model")
-			sqlFields[name] = "'"+getDB()->escape(boost::get<string>(val))+"'";
+		//the deltas could have cancelled out
+		else if (CharFieldInfo[i].kind == KIND_ADDITION && update.additions[i] == 0)
+			continue;
+
+		mask |= bit;
 	}
 
-	if (sqlFields.size() > 0)
+	if (mask == 0)
+		return true;
+
+	//statements are made from the flush timer as well
+	Poco::ScopedLock<Poco::FastMutex> guard(_stmtLock);
+
+	//every combination of fields gets its own prepared statement
+	auto stmt = getDB()->makeStatement(_stmtUpdateCharacter[mask], updateCharacterSql(mask));
+	for (int i=0; i<NUM_CHAR_FIELDS; i++)
 	{
-		string query = "UPDATE `Character_DATA` SET ";
-		for (auto it=sqlFields.begin();it!=sqlFields.end();)
+		if ((mask & (1u << i)) == 0)
+			continue;
+
+		switch (CharFieldInfo[i].kind)
 		{
-			string fieldName = it->first;
-			if (fieldName == "Worldspace")
-				fieldName = _wsFieldName;
+		case KIND_ARRAY:
+			//turned into text by the async thread
+			stmt->addDeferredString(SerializeLater(update.arrays[i]));
+			break;
+		case KIND_TIMESTAMP:
+			//seconds since it happened, as it could have waited for the flush
+			stmt->addInt32(static_cast<int>(update.stamps[i].elapsed() / Poco::Timestamp::resolution()));
+			break;
+		case KIND_ADDITION:
+			stmt->addInt32(update.additions[i]);
+			break;
+		case KIND_STRING:
+			stmt->addString(update.model);
+			break;
+		}
+	}
+	stmt->addInt32(update.serverId);
+	stmt->addInt32(characterId);
+
+	bool exRes = stmt->execute();
+	poco_assert(exRes == true);
 
-			query += "`" + fieldName + "` = " + it->second;
-			++it;
-			if (it != sqlFields.end())
-				query += " , ";
+	//so the same values aren't skipped next time
+	if (!exRes)
+	{
+		for (int i=0; i<NUM_CHAR_FIELDS; i++)
+		{
+			if ((mask & (1u << i)) != 0 && CharFieldInfo[i].kind == KIND_ARRAY)
+				_writtenHashes.forget(characterId,ArrayFieldColumn(static_cast<CharField>(i)));
 		}
-		query += ", `InstanceID` = " + lexical_cast<string>(serverId) + "  WHERE `CharacterID` = " + lexical_cast<string>(characterId);
-		bool exRes = getDB()->execute(query.c_str());
-		poco_assert(exRes == true);
+	}
 
-		return exRes;
+	return exRes;
+}
+
+CurrencyLedger::WriteResult SqlCharDataSource::writeMoney( int characterId, int delta, UInt64 seq )
+{
+	if (!_ledger->isJournalled())
+	{
+		auto stmt = getDB()->makeStatement(_stmtAddMoney, "UPDATE `Character_DATA` SET `Money` = `Money` + ? WHERE `CharacterID` = ?");
+		stmt->addInt32(delta);
+		stmt->addInt32(characterId);
+		return stmt->execute() ? CurrencyLedger::WRITE_DONE : CurrencyLedger::WRITE_FAILED;
 	}
 
+	//direct, as the journal lets go of it once this returns
+	string sql = "UPDATE `Character_DATA` SET `Money` = `Money` + " + lexical_cast<string>(delta) + ", `MoneySeq` = " + lexical_cast<string>(seq) + 
+		" WHERE `CharacterID` = " + lexical_cast<string>(characterId);
+	UInt64 numChanged = 0;
+	if (!getDB()->directExecute(sql.c_str(),numChanged))
+		return CurrencyLedger::WRITE_FAILED;
+
+	return (numChanged > 0) ? CurrencyLedger::WRITE_DONE : CurrencyLedger::WRITE_NO_ROW;
+}
+
+bool SqlCharDataSource::readMoneySeq( int characterId, UInt64& seq )
+{
+	auto seqRes = getDB()->queryParams("SELECT `MoneySeq` FROM `Character_DATA` WHERE `CharacterID` = %d", characterId);
+	if (!seqRes)
+		return false;
+
+	seq = seqRes->fetchRow() ? seqRes->at(0).getUInt64() : 0;
 	return true;
 }
 
-bool SqlCharDataSource::initCharacter( int characterId, const Sqf::Value& inventory, const Sqf::Value& backpack )
+void SqlCharDataSource::flushMoney( int characterId )
+{
+	auto write = boost::bind(&SqlCharDataSource::writeMoney,this,_1,_2,_3);
+	auto readSeq = boost::bind(&SqlCharDataSource::readMoneySeq,this,_1,_2);
+	if (characterId != 0)
+		_ledger->flush(CurrencyLedger::ACCOUNT_CHARACTER,characterId,write,readSeq);
+	else
+		_ledger->flush(CurrencyLedger::ACCOUNT_CHARACTER,write,readSeq);
+}
+
+void SqlCharDataSource::onFlushTimer( Poco::Timer& timer )
+{
+	getDB()->threadEnter();
+	flushCharacters();
+	flushMoney();
+	flushLogins();
+	getDB()->threadExit();
+}
+
+void SqlCharDataSource::flushCharacters()
+{
+	PendingUpdateMap pending;
+	{
+		Poco::ScopedLock<Poco::FastMutex> guard(_pendingLock);
+		pending.swap(_pendingUpdates);
+	}
+	if (pending.empty())
+		return;
+
+	for (auto it=pending.cbegin(); it!=pending.cend(); ++it)
+		writeCharacter(it->first,it->second);
+
+	_logger.debug("Flushed " + lexical_cast<string>(pending.size()) + " characters, character writes: " + _writtenHashes.stats());
+}
+
+bool SqlCharDataSource::hasPendingUpdate( int characterId )
+{
+	Poco::ScopedLock<Poco::FastMutex> guard(_pendingLock);
+	return (_pendingUpdates.count(characterId) > 0);
+}
+
+void SqlCharDataSource::flushCharacter( int characterId )
+{
+	PendingUpdate update;
+	{
+		Poco::ScopedLock<Poco::FastMutex> guard(_pendingLock);
+		auto it = _pendingUpdates.find(characterId);
+		if (it == _pendingUpdates.end())
+			return;
+
+		update = std::move(it->second);
+		_pendingUpdates.erase(it);
+	}
+
+	writeCharacter(characterId,update);
+}
+
+bool SqlCharDataSource::initCharacter( int characterId, Sqf::Value inventory, Sqf::Value backpack )
 {
+	_prefetch.invalidate(characterId);
+	_writtenHashes.changed(characterId,WRITTEN_INVENTORY,PersistedHashes::Hash(inventory));
+	_writtenHashes.changed(characterId,WRITTEN_BACKPACK,PersistedHashes::Hash(backpack));
+
+	CharacterCache::ValuePtr sharedInv = make_shared<Sqf::Value>(std::move(inventory));
+	CharacterCache::ValuePtr sharedBp = make_shared<Sqf::Value>(std::move(backpack));
+	if (CharacterCache::Entry* cached = _cache.find(characterId))
+	{
+		cached->inventory = sharedInv;
+		cached->backpack = sharedBp;
+	}
+
 	auto stmt = getDB()->makeStatement(_stmtInitCharacter, "UPDATE `Character_DATA` SET `Inventory` = ? , `Backpack` = ? WHERE `CharacterID` = ?");
-	stmt->addString(lexical_cast<string>(inventory));
-	stmt->addString(lexical_cast<string>(backpack));
+	stmt->addDeferredString(SerializeLater(sharedInv));
+	stmt->addDeferredString(SerializeLater(sharedBp));
 	stmt->addInt32(characterId);
 	bool exRes = stmt->execute();
 	poco_assert(exRes == true);
 
+	if (!exRes)
+	{
+		_writtenHashes.forget(characterId,WRITTEN_INVENTORY);
+		_writtenHashes.forget(characterId,WRITTEN_BACKPACK);
+	}
+
 	return exRes;
 }
 
 bool SqlCharDataSource::killCharacter( int characterId, int duration, int infected )
 {
+	_prefetch.invalidate(characterId);
+
+	//the ledger writes the money directly, and lets go of it as soon as it's in
+	flushMoney(characterId);
+
+	//the last stats of the character go out together with it being marked dead
+	UnitOfWork work(*getDB());
+	flushCharacter(characterId);
+
 	auto stmt = getDB()->makeStatement(_stmtKillCharacter, 
 		"UPDATE `Character_DATA` SET `Alive` = 0, `Infected` = ?, `LastLogin` = DATE_SUB(CURRENT_TIMESTAMP, INTERVAL ? MINUTE) WHERE `CharacterID` = ? AND `Alive` = 1");
 	stmt->addInt32(infected);
@@ -492,20 +1189,77 @@ bool SqlCharDataSource::killCharacter( int characterId, int duration, int infect
 	bool exRes = stmt->execute();
 	poco_assert(exRes == true);
 
+	_writtenHashes.forget(characterId);
+	_cache.remove(characterId);
+	CharacterSummaries::Slot* summary = _summaries.findCharacter(characterId);
+	if (summary && summary->alive)
+	{
+		summary->alive = false;
+		summary->infected = infected;
+		summary->lastLogin = CharacterCache::MinutesAgo(duration);
+	}
+
 	return exRes;
 }
 
 bool SqlCharDataSource::recordLogin( string playerId, int characterId, int action )
 {
-	auto stmt = getDB()->makeStatement(_stmtRecordLogin, 
-		"INSERT INTO `Player_LOGIN` (`"+_idFieldName+"`, `CharacterID`, `Datestamp`, `Action`) VALUES (?, ?, CURRENT_TIMESTAMP, ?)");
-	stmt->addString(playerId);
-	stmt->addInt32(characterId);
-	stmt->addInt32(action);
-	bool exRes = stmt->execute();
-	poco_assert(exRes == true);
+	_prefetch.invalidate(characterId);
 
-	return exRes;
+	//might be played on another server next, which we wouldn't know about
+	if (action == LOGIN_ACTION_LOGOUT)
+	{
+		flushCharacter(characterId);
+		flushMoney(characterId);
+		_cache.remove(characterId);
+	}
+
+	PendingLogin login;
+	login.escapedId = getDB()->escape(playerId);
+	login.characterId = characterId;
+	login.action = action;
+	{
+		Poco::ScopedLock<Poco::FastMutex> guard(_pendingLock);
+		_pendingLogins.push_back(std::move(login));
+	}
+
+	if (_flushInterval <= 0)
+		flushLogins();
+
+	return true;
+}
+
+void SqlCharDataSource::flushLogins()
+{
+	vector<PendingLogin> pending;
+	{
+		Poco::ScopedLock<Poco::FastMutex> guard(_pendingLock);
+		pending.swap(_pendingLogins);
+	}
+
+	for (size_t first=0; first<pending.size(); first+=LOGIN_ROWS_PER_INSERT)
+	{
+		size_t end = first + LOGIN_ROWS_PER_INSERT;
+		if (end > pending.size())
+			end = pending.size();
+
+		string sql = "INSERT INTO `Player_LOGIN` (`" + _idFieldName + "`, `CharacterID`, `Datestamp`, `Action`) VALUES ";
+		for (size_t i=first; i<end; i++)
+		{
+			const PendingLogin& login = pending[i];
+			if (i > first)
+				sql += ", ";
+
+			//seconds since it happened, as it could have waited for the flush
+			sql += "('" + login.escapedId + "', " + lexical_cast<string>(login.characterId) + ", "
+				"DATE_SUB(CURRENT_TIMESTAMP, INTERVAL " + lexical_cast<string>(login.when.elapsed() / Poco::Timestamp::resolution()) + " SECOND), " + 
+				lexical_cast<string>(login.action) + ")";
+		}
+
+		//only an audit trail, the game doesn't wait on it
+		bool exRes = getDB()->executeLowPriority(sql.c_str());
+		poco_assert(exRes == true);
+	}
 }
 
 Sqf::Value SqlCharDataSource::fetchTraderObject( int traderObjectId, int action)
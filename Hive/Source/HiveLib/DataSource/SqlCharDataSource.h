@@ -20,20 +20,32 @@
 
 #include "SqlDataSource.h"
 #include "CharDataSource.h"
+#include "PersistedHashes.h"
+#include "CharacterCache.h"
+#include "CharacterSummaries.h"
+#include "LoginPrefetch.h"
+#include "CurrencyLedger.h"
 #include "Database/SqlStatement.h"
 
+#include <Poco/Timer.h>
+#include <Poco/Mutex.h>
+#include <algorithm>
+
+class QueryResult;
 class SqlCharDataSource : public SqlDataSource, public CharDataSource
 {
 public:
-	SqlCharDataSource(Poco::Logger& logger, shared_ptr<Database> db, const string& idFieldName, const string& wsFieldName);
+	SqlCharDataSource(Poco::Logger& logger, shared_ptr<Database> db, const string& idFieldName, const string& wsFieldName, 
+		shared_ptr<CurrencyLedger> ledger, UInt32 cacheIdleExpiry = 0, long flushInterval = 0, UInt32 prefetchTTL = 0);
 	~SqlCharDataSource();
 
 	Sqf::Value fetchCharacters( string playerId ) override;
 	Sqf::Value fetchCharacterInitial( string playerId, int serverId, const string& playerName, int characterSlot ) override;
 	Sqf::Value fetchCharacterDetails( int characterId ) override;
+	void fetchCharacterDetailsBulk( const vector<int>& characterIds, DetailsQueue& outDetails ) override;
 	Sqf::Value fetchTraderObject( int traderObjectId, int action) override;
-	bool updateCharacter( int characterId, int serverId, const FieldsType& fields ) override;
-	bool initCharacter( int characterId, const Sqf::Value& inventory, const Sqf::Value& backpack ) override;
+	bool updateCharacter( int characterId, int serverId, FieldsType fields ) override;
+	bool initCharacter( int characterId, Sqf::Value inventory, Sqf::Value backpack ) override;
 	bool killCharacter( int characterId, int duration, int infected ) override;
 	bool recordLogin( string playerId, int characterId, int action ) override;
 
@@ -41,14 +53,84 @@ private:
 	string _idFieldName;
 	string _wsFieldName;
 
+	//what was last written to the array fields of each character, by CharacterID
+	PersistedHashes _writtenHashes;
+
+	//live characters, kept current by the writes that go through here
+	CharacterCache _cache;
+	Sqf::Value cachedCharacterInitial( CharacterCache::Entry& cached, const string& playerName );
+	//reads Medical, Generation, KillsZ, HeadshotsZ, KillsH, KillsB, CurrentState, Humanity, InstanceID, Money starting at firstCol
+	void readDetails( const QueryResult& res, size_t firstCol, CharacterCache::Details& details, int characterId );
+	static Sqf::Value DetailsResult( const CharacterCache::Details& details, const Sqf::Value& worldSpace );
+
+	//the character lists of the players, so 100 doesn't have to look for the latest characters every time
+	CharacterSummaries _summaries;
+
+	//101 query results for the live slots 100 just listed, dropped once anything is written for that character
+	LoginPrefetch _prefetch;
+	string loginSql( const string& playerId, int characterSlot ) const;
+
+	void changePlayerName( const string& playerId, const string& oldName, const string& newName );
+	void updateLastLogin( int characterId );
+
+	//201 changes of each character are merged, and written out every _flushInterval ms (and on death or logout)
+	//the counters (kills, distance, humanity...) are written as they come in instead
+	struct PendingUpdate
+	{
+		PendingUpdate() : serverId(0), mask(0) { std::fill(additions,additions+NUM_CHAR_FIELDS,0); }
+
+		int serverId;
+		UInt32 mask;
+		CharacterCache::ValuePtr arrays[NUM_CHAR_FIELDS];	//latest value
+		Poco::Timestamp stamps[NUM_CHAR_FIELDS];			//when the player last ate/drank
+		int additions[NUM_CHAR_FIELDS];						//sum of the deltas
+		string model;
+
+		void merge( PendingUpdate& newer );
+	};
+	typedef map<int,PendingUpdate> PendingUpdateMap;
+	PendingUpdateMap _pendingUpdates;
+	Poco::FastMutex _pendingLock;
+	long _flushInterval;
+	Poco::Timer _flushTimer;
+
+	void onFlushTimer( Poco::Timer& timer );
+	void flushCharacters();
+	void flushCharacter( int characterId );
+	bool hasPendingUpdate( int characterId );
+	bool writeCharacter( int characterId, const PendingUpdate& update );
+
+	//money deltas of the characters are kept by the ledger, and written with the other flushes
+	shared_ptr<CurrencyLedger> _ledger;
+	CurrencyLedger::WriteResult writeMoney( int characterId, int delta, UInt64 seq );
+	bool readMoneySeq( int characterId, UInt64& seq );
+	void flushMoney( int characterId = 0 );
+
+	//Player_LOGIN records (103), inserted many rows at a time on the same flush
+	struct PendingLogin
+	{
+		string escapedId;
+		int characterId;
+		int action;
+		Poco::Timestamp when;
+	};
+	vector<PendingLogin> _pendingLogins;
+	void flushLogins();
+
+	//character updates, by mask of the fields they write
+	map<UInt32,SqlStatementID> _stmtUpdateCharacter;
+	map<UInt32,string> _updateCharacterSql;
+	Poco::FastMutex _stmtLock;
+	const string& updateCharacterSql( UInt32 mask );
+
 	//statement ids
 	SqlStatementID _stmtChangePlayerName;
 	SqlStatementID _stmtInsertPlayer;
 	SqlStatementID _stmtUpdateCharacterLastLogin;
 	SqlStatementID _stmtInsertNewCharacter;
+	SqlStatementID _stmtAddMoney;
 	SqlStatementID _stmtInitCharacter;
 	SqlStatementID _stmtKillCharacter;
-	SqlStatementID _stmtRecordLogin;
 	SqlStatementID _stmtTradeObjectBuy;
 	SqlStatementID _stmtTradeObjectSell;
 };
\ No newline at end of file
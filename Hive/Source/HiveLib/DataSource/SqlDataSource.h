@@ -19,6 +19,9 @@
 #pragma once 
 
 #include "DataSource.h"
+#include "Database/SqlStatement.h"
+
+#include <boost/lexical_cast.hpp>
 
 class Database;
 class SqlDataSource : public DataSource
@@ -28,6 +31,17 @@ public:
 	~SqlDataSource() {}
 protected:
 	Database* getDB() const { return _db.get(); }
+
+	//the value only gets turned into text when the statement runs, instead of on the calling thread
+	static DeferredString SerializeLater(Sqf::Value val)
+	{
+		shared_ptr<const Sqf::Value> sharedVal = make_shared<Sqf::Value>(std::move(val));
+		return [sharedVal]() { return boost::lexical_cast<string>(*sharedVal); };
+	}
+	static DeferredString SerializeLater(shared_ptr<const Sqf::Value> sharedVal)
+	{
+		return [sharedVal]() { return boost::lexical_cast<string>(*sharedVal); };
+	}
 private:
 	shared_ptr<Database> _db;
 };
\ No newline at end of file
@@ -21,6 +21,14 @@
 
 #include <boost/format.hpp>
 #include <boost/lexical_cast.hpp>
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
+#include "Shared/Common/Timer.h"
+#include <Poco/Timestamp.h>
+
+#include <iterator>
+#include <algorithm>
 
 #define PRIu64 "I64u"
 
@@ -72,66 +80,260 @@ namespace
 	};
 
 	PositionInfo FixOOBWorldspace(Sqf::Value& v) { return boost::apply_visitor(WorldspaceFixerVisitor(),v); }
+
+	//worldspace is [dir,[x,y,z]]
+	bool WorldspacePosition(const Sqf::Value& ws, double& outX, double& outY)
+	{
+		try
+		{
+			const Sqf::Parameters& wsArr = boost::get<Sqf::Parameters>(ws);
+			if (wsArr.size() != 2)
+				return false;
+
+			const Sqf::Parameters& pos = boost::get<Sqf::Parameters>(wsArr[1]);
+			if (pos.size() < 2)
+				return false;
+
+			outX = Sqf::GetDouble(pos[0]);
+			outY = Sqf::GetDouble(pos[1]);
+			return true;
+		}
+		catch(const boost::bad_get&) {}
+
+		return false;
+	}
+
+	//columns tracked by _writtenHashes
+	enum WrittenColumn
+	{
+		WRITTEN_INVENTORY,
+		WRITTEN_MOVEMENT,	//worldspace and fuel
+		WRITTEN_STATUS		//hitpoints and damage
+	};
 };
 
 #include <Poco/Util/AbstractConfiguration.h>
-SqlObjDataSource::SqlObjDataSource( Poco::Logger& logger, shared_ptr<Database> db, const Poco::Util::AbstractConfiguration* conf ) : SqlDataSource(logger,db)
+SqlObjDataSource::SqlObjDataSource( Poco::Logger& logger, shared_ptr<Database> db, const Poco::Util::AbstractConfiguration* conf, shared_ptr<CurrencyLedger> ledger ) 
+	: SqlDataSource(logger,db), _ledger(std::move(ledger)), _writtenHashes(boost::bind(&Database::droppedOperations,getDB())), _cleanupRunner(*this,&SqlObjDataSource::cleanupPlacedObjects), _cleanupThread("Placed Objects Cleanup"),
+	_leaseRunner(*this,&SqlObjDataSource::leaseIdBlocks), _leaseThread("ObjectID Lease")
 {
 	static const string defaultTable = "Object_DATA"; 
 	if (conf != NULL)
 	{
 		_objTableName = getDB()->escape(conf->getString("Table",defaultTable));
 		_cleanupPlacedDays = conf->getInt("CleanupPlacedAfterDays",6);
+		_cleanupChunkSize = conf->getInt("CleanupChunkSize",500);
+		_loadConnections = conf->getInt("LoadConnections",1);
+		_flushInterval = conf->getInt("FlushInterval",5) * 1000;
+		_idBlockSize = conf->getInt("IDBlockSize",0);
 		_vehicleOOBReset = conf->getBool("ResetOOBVehicles",false);
+		_objGrid.reset(conf->getDouble("GridCellSize",100.0));
 	}
 	else
 	{
 		_objTableName = defaultTable;
 		_cleanupPlacedDays = -1;
+		_cleanupChunkSize = 500;
+		_loadConnections = 1;
+		_flushInterval = 0;
+		_idBlockSize = 0;
 		_vehicleOOBReset = false;
 	}
+
+	if (_cleanupChunkSize < 1)
+		_cleanupChunkSize = 1;
+
+	_nextLeasedId = _leaseEnd = 0;
+	_spareStart = _spareEnd = 0;
+	_leasePending = false;
+	_leaseStop = false;
+	if (_idBlockSize < 0)
+		_idBlockSize = 0;
+	if (_idBlockSize > 0)
+		_leaseThread.start(_leaseRunner);
+
+	if (_flushInterval > 0)
+	{
+		_flushTimer.setStartInterval(_flushInterval);
+		_flushTimer.setPeriodicInterval(_flushInterval);
+		_flushTimer.start(Poco::TimerCallback<SqlObjDataSource>(*this,&SqlObjDataSource::onFlushTimer));
+	}
+
+	//whatever the last run left in the money journal goes out before the objects are loaded
+	flushMoney();
+}
+
+SqlObjDataSource::~SqlObjDataSource()
+{
+	//whatever is still dirty goes out before the database does
+	_flushTimer.stop();
+	flushVehicles();
+	flushMoney();
+	_logger.information("Object writes: " + _writtenHashes.stats());
+
+	_cleanupStop.set();
+	if (_cleanupThread.isRunning())
+		_cleanupThread.join();
+
+	_leaseStop = true;
+	_leaseWanted.set();
+	if (_leaseThread.isRunning())
+		_leaseThread.join();
+}
+
+void SqlObjDataSource::onFlushTimer( Poco::Timer& timer )
+{
+	getDB()->threadEnter();
+	flushVehicles();
+	flushMoney();
+	getDB()->threadExit();
 }
 
-void SqlObjDataSource::populateObjects( int serverId, ServerObjectsQueue& queue )
+void SqlObjDataSource::flushVehicles()
 {
-	if (_cleanupPlacedDays >= 0)
+	DirtyVehicleMap dirty;
 	{
-		string commonSql = "FROM `"+_objTableName+"` WHERE `Instance` = " + lexical_cast<string>(serverId) +
-			" AND `ObjectUID` <> 0 AND `CharacterID` <> 0" +
-			" AND `Datestamp` < DATE_SUB(CURRENT_TIMESTAMP, INTERVAL "+lexical_cast<string>(_cleanupPlacedDays)+" DAY)" +
-			" AND ( (`Inventory` IS NULL) OR (`Inventory` = '[]') )";
+		Poco::ScopedLock<Poco::FastMutex> guard(_dirtyLock);
+		dirty.swap(_dirtyVehicles);
+	}
+	if (dirty.empty())
+		return;
 
-		int numCleaned = 0;
+	//all the vehicles go out in a few multi-row statements, one set per instance
+	typedef map<int,BulkUpdate> BulkUpdates;
+	BulkUpdates movements, statuses;
+	auto bulkFor = [&](BulkUpdates& updates, int serverId, const char* firstCol, const char* secondCol) -> BulkUpdate&
+	{
+		auto it = updates.find(serverId);
+		if (it == updates.end())
 		{
-			auto numObjsToClean = getDB()->query(("SELECT COUNT(*) "+commonSql).c_str());
-			if (numObjsToClean && numObjsToClean->fetchRow())
-				numCleaned = numObjsToClean->at(0).getInt32();
+			BulkUpdate newUpdate(_objTableName,"ObjectID");
+			newUpdate.columns.push_back(firstCol);
+			newUpdate.columns.push_back(secondCol);
+			newUpdate.filters.push_back(std::make_pair(string("Instance"),lexical_cast<string>(serverId)));
+			it = updates.insert(std::make_pair(serverId,std::move(newUpdate))).first;
 		}
-		if (numCleaned > 0)
+		return it->second;
+	};
+
+	for (auto it=dirty.cbegin(); it!=dirty.cend(); ++it)
+	{
+		const DirtyVehicle& veh = it->second;
+		string objectId = lexical_cast<string>(it->first);
+		if (veh.moved && _writtenHashes.changed(it->first,WRITTEN_MOVEMENT,PersistedHashes::Hash(veh.fuel,PersistedHashes::Hash(veh.worldspace))))
 		{
-			_logger.information("Removing " + lexical_cast<string>(numCleaned) + " empty placed objects older than " + lexical_cast<string>(_cleanupPlacedDays) + " days");
+			vector<string> values;
+			values.push_back("'" + getDB()->escape(lexical_cast<string>(veh.worldspace)) + "'");
+			values.push_back(lexical_cast<string>(veh.fuel));
+			bulkFor(movements,veh.serverId,"Worldspace","Fuel").addRow(objectId,std::move(values));
+		}
+		if (veh.statusChanged && _writtenHashes.changed(it->first,WRITTEN_STATUS,PersistedHashes::Hash(veh.damage,PersistedHashes::Hash(veh.hitPoints))))
+		{
+			vector<string> values;
+			values.push_back("'" + getDB()->escape(lexical_cast<string>(veh.hitPoints)) + "'");
+			values.push_back(lexical_cast<string>(veh.damage));
+			bulkFor(statuses,veh.serverId,"Hitpoints","Damage").addRow(objectId,std::move(values));
+		}
+	}
 
-			auto stmt = getDB()->makeStatement(_stmtDeleteOldObject, "DELETE "+commonSql);
-			if (!stmt->directExecute())
-				_logger.error("Error executing placed objects cleanup statement");
+	size_t numRows = 0;
+	size_t numStatements = 0;
+	BulkUpdates* allUpdates[] = { &movements, &statuses };
+	WrittenColumn updateColumns[] = { WRITTEN_MOVEMENT, WRITTEN_STATUS };
+	for (size_t i=0; i<sizeof(allUpdates)/sizeof(allUpdates[0]); i++)
+	{
+		for (auto it=allUpdates[i]->cbegin(); it!=allUpdates[i]->cend(); ++it)
+		{
+			size_t stmtsUsed = getDB()->executeBulkUpdate(it->second);
+			if (stmtsUsed == 0)
+			{
+				_logger.error("Failed to queue " + lexical_cast<string>(it->second.rows.size()) + " vehicle updates");
+				//so the same values aren't skipped next time
+				for (auto rowIt=it->second.rows.cbegin(); rowIt!=it->second.rows.cend(); ++rowIt)
+					_writtenHashes.forget(lexical_cast<Int64>(rowIt->key),updateColumns[i]);
+			}
+
+			numRows += it->second.rows.size();
+			numStatements += stmtsUsed;
 		}
 	}
-	
-	auto worldObjsRes = getDB()->queryParams("SELECT `ObjectID`, `Classname`, `CharacterID`, `Worldspace`, `Inventory`, `Hitpoints`, `Fuel`, `Damage` FROM `%s` WHERE `Instance`=%d AND `Classname` IS NOT NULL", _objTableName.c_str(), serverId);
+
+	_logger.debug("Flushed " + lexical_cast<string>(dirty.size()) + " vehicles, " + lexical_cast<string>(numRows) + " rows in " + 
+		lexical_cast<string>(numStatements) + " statements, object writes: " + _writtenHashes.stats());
+}
+
+namespace { const long CLEANUP_CHUNK_DELAY = 100; const int CLEANUP_PROGRESS_CHUNKS = 20; };
+
+void SqlObjDataSource::cleanupPlacedObjects()
+{
+	getDB()->threadEnter();
+
+	UInt64 totalCleaned = 0;
+	int numChunks = 0;
+	for (;;)
+	{
+		UInt64 numCleaned = 0;
+		if (!getDB()->directExecute(_cleanupSql.c_str(),numCleaned))
+		{
+			_logger.error("Error executing placed objects cleanup statement");
+			break;
+		}
+
+		totalCleaned += numCleaned;
+		numChunks++;
+		if (numCleaned > 0)
+			_logger.debug("Placed objects cleanup removed " + lexical_cast<string>(numCleaned) + " rows (" + lexical_cast<string>(totalCleaned) + " total)");
+
+		if (numCleaned < static_cast<UInt64>(_cleanupChunkSize))
+			break;
+
+		if (numChunks % CLEANUP_PROGRESS_CHUNKS == 0)
+			_logger.information("Placed objects cleanup in progress, removed " + lexical_cast<string>(totalCleaned) + " rows in " + lexical_cast<string>(numChunks) + " chunks so far");
+
+		//give the other queries a chance between chunks
+		if (_cleanupStop.tryWait(CLEANUP_CHUNK_DELAY))
+			break;
+	}
+	_logger.information("Removed " + lexical_cast<string>(totalCleaned) + " empty placed objects older than " + lexical_cast<string>(_cleanupPlacedDays) + 
+		" days in " + lexical_cast<string>(numChunks) + " chunks");
+
+	getDB()->threadExit();
+}
+
+namespace
+{
+	class FunctionRunnable : public Poco::Runnable
+	{
+	public:
+		FunctionRunnable(boost::function<void()> func) : _func(std::move(func)) {}
+		void run() override { _func(); }
+	private:
+		boost::function<void()> _func;
+	};
+};
+
+bool SqlObjDataSource::loadObjects( const string& whereSql, size_t connIdx, ServerObjectsQueue& queue, LoadedObjects& loaded )
+{
+	//streamed, so rows get decoded while the rest of them are still coming in
+	string loadSql = "SELECT `ObjectID`, `Classname`, `CharacterID`, `Worldspace`, `Inventory`, `Hitpoints`, `Fuel`, `Damage`, `ObjectUID` FROM `" + _objTableName + "` WHERE " + whereSql;
+	auto worldObjsRes = getDB()->queryStreamedOn(connIdx,loadSql.c_str());
 	if (!worldObjsRes)
 	{
 		_logger.error("Failed to fetch objects from database");
-		return;
+		return false;
 	}
 	while (worldObjsRes->fetchRow())
 	{
-		auto row = worldObjsRes->fields();
+		const auto& row = worldObjsRes->fields();
 
 		Sqf::Parameters objParams;
 		objParams.push_back(string("OBJ"));
 
 		int objectId = row[0].getInt32();
 		objParams.push_back(lexical_cast<string>(objectId)); //objectId should be stringified
+
+		bool hasPos = false;
+		double posX = 0, posY = 0;
 		try
 		{
 			objParams.push_back(row[1].getString()); //classname
@@ -145,7 +347,8 @@ void SqlObjDataSource::populateObjects( int serverId, ServerObjectsQueue& queue
 					_logger.information("Reset ObjectID " + lexical_cast<string>(objectId) + " (" + row[1].getString() + ") from position " + lexical_cast<string>(*posInfo));
 
 			}
-			objParams.push_back(worldSpace);
+			hasPos = WorldspacePosition(worldSpace,posX,posY);
+			objParams.push_back(std::move(worldSpace));
 
 			//Inventory can be NULL
 			{
@@ -165,14 +368,208 @@ void SqlObjDataSource::populateObjects( int serverId, ServerObjectsQueue& queue
 			continue;
 		}
 
-		queue.push(objParams);
+		LoadedObject obj;
+		obj.objectId = objectId;
+		obj.objectUid = static_cast<Int64>(row[8].getUInt64());
+		obj.ownerId = row[2].getInt32();
+		obj.className = row[1].getString();
+		obj.hasPos = hasPos;
+		obj.posX = posX;
+		obj.posY = posY;
+		loaded.push_back(std::move(obj));
+
+		queue.push_back(std::move(objParams));
+	}
+
+	//the rows we got aren't the whole set, so none of them count
+	if (worldObjsRes->failed())
+	{
+		_logger.error("Object stream broke off after " + lexical_cast<string>(worldObjsRes->numRows()) + " rows");
+		return false;
+	}
+
+	return true;
+}
+
+void SqlObjDataSource::indexObjects( const LoadedObjects& loaded )
+{
+	for (auto it=loaded.cbegin(); it!=loaded.cend(); ++it)
+	{
+		_uidIndex.insert(it->objectUid,it->objectId);
+		_ownerIndex.insert(it->ownerId,it->objectId,it->objectUid);
+		if (it->hasPos)
+			_objGrid.insert(it->objectId,it->objectUid,it->className,it->posX,it->posY);
+	}
+}
+
+namespace { const int OBJECT_LOAD_ATTEMPTS = 3; const long OBJECT_LOAD_RETRY_DELAY = 2000; };
+
+bool SqlObjDataSource::populateObjects( int serverId, ServerObjectsQueue& queue )
+{
+	//objects that will be removed by the cleanup are left out of the load
+	string cleanupFilter;
+	if (_cleanupPlacedDays >= 0 && !_cleanupThread.isRunning())
+	{
+		//fix the cutoff time, so the load and the cleanup agree on what gets removed
+		string cutoffTime;
+		{
+			auto cutoffRes = getDB()->queryParams("SELECT DATE_SUB(CURRENT_TIMESTAMP, INTERVAL %d DAY)", _cleanupPlacedDays);
+			if (cutoffRes && cutoffRes->fetchRow())
+				cutoffTime = cutoffRes->at(0).getString();
+		}
+		if (cutoffTime.length() > 0)
+		{
+			string cleanupCond = "`ObjectUID` <> 0 AND `CharacterID` <> 0"
+				" AND `Datestamp` < '" + getDB()->escape(cutoffTime) + "'"
+				" AND ( (`Inventory` IS NULL) OR (`Inventory` = '[]') )";
+
+			cleanupFilter = " AND IFNULL(("+cleanupCond+"),0) = 0";
+			_cleanupSql = "DELETE FROM `"+_objTableName+"` WHERE `Instance` = " + lexical_cast<string>(serverId) + 
+				" AND " + cleanupCond + " LIMIT " + lexical_cast<string>(_cleanupChunkSize);
+		}
+		else
+			_logger.error("Failed to get placed objects cleanup cutoff time");
+	}
+
+	string whereSql = "`Instance` = " + lexical_cast<string>(serverId) + " AND `Classname` IS NOT NULL" + cleanupFilter;
+
+	//never hand out part of the world, either all of it loads or nothing does
+	bool loaded = false;
+	for (int attempt=1; attempt<=OBJECT_LOAD_ATTEMPTS; attempt++)
+	{
+		queue.clear();
+		_objGrid.reset();
+		_uidIndex.clear();
+		_ownerIndex.clear();
+
+		loaded = loadObjectRanges(whereSql,queue);
+		if (loaded)
+			break;
+
+		if (attempt < OBJECT_LOAD_ATTEMPTS)
+		{
+			_logger.warning("Object load failed, retrying (attempt " + lexical_cast<string>(attempt+1) + " of " + lexical_cast<string>(OBJECT_LOAD_ATTEMPTS) + ")");
+			Poco::Thread::sleep(OBJECT_LOAD_RETRY_DELAY);
+		}
+	}
+	if (!loaded)
+	{
+		_logger.error("Failed to load objects after " + lexical_cast<string>(OBJECT_LOAD_ATTEMPTS) + " attempts");
+		queue.clear();
+		_objGrid.reset();
+		_uidIndex.clear();
+		_ownerIndex.clear();
+		return false;
+	}
+
+	//so the first objects published don't have to wait for it
+	if (_idBlockSize > 0)
+	{
+		Poco::ScopedLock<Poco::FastMutex> guard(_leaseLock);
+		if (_nextLeasedId >= _leaseEnd && _spareStart >= _spareEnd && !_leasePending)
+		{
+			_leasePending = true;
+			_leaseWanted.set();
+		}
 	}
+
+	if (cleanupFilter.length() > 0)
+	{
+		_logger.information("Removing empty placed objects older than " + lexical_cast<string>(_cleanupPlacedDays) + " days in the background");
+		_cleanupStop.reset();
+		_cleanupThread.start(_cleanupRunner);
+	}
+
+	return true;
+}
+
+bool SqlObjDataSource::loadObjectRanges( const string& whereSql, ServerObjectsQueue& queue )
+{
+	//split the ObjectID range between the load connections, each range gets a connection of its own
+	size_t numConnections = std::min(static_cast<size_t>(_loadConnections),getDB()->queryConnections());
+	vector< std::pair<Int64,Int64> > idRanges;
+	if (numConnections > 1)
+	{
+		auto idBoundsRes = getDB()->queryParams("SELECT MIN(`ObjectID`), MAX(`ObjectID`) FROM `%s` WHERE %s", _objTableName.c_str(), whereSql.c_str());
+		if (idBoundsRes && idBoundsRes->fetchRow() && !idBoundsRes->at(0).isNull())
+		{
+			Int64 minId = static_cast<Int64>(idBoundsRes->at(0).getUInt64());
+			Int64 maxId = static_cast<Int64>(idBoundsRes->at(1).getUInt64());
+			Int64 rangeSize = (maxId - minId) / static_cast<Int64>(numConnections) + 1;
+			for (Int64 rangeStart=minId; rangeStart<=maxId; rangeStart+=rangeSize)
+				idRanges.push_back(std::make_pair(rangeStart,std::min(rangeStart+rangeSize-1,maxId)));
+		}
+	}
+
+	if (idRanges.size() < 2)
+	{
+		LoadedObjects loaded;
+		if (!loadObjects(whereSql,0,queue,loaded))
+			return false;
+
+		indexObjects(loaded);
+		return true;
+	}
+
+	UInt32 startTime = GlobalTimer::getMSTime();
+
+	vector<ServerObjectsQueue> rangeObjs(idRanges.size());
+	vector<LoadedObjects> rangeLoaded(idRanges.size());
+	vector<string> rangeSql(idRanges.size());
+	for (size_t i=0; i<idRanges.size(); i++)
+	{
+		rangeSql[i] = whereSql + " AND `ObjectID` BETWEEN " + lexical_cast<string>(idRanges[i].first) + 
+			" AND " + lexical_cast<string>(idRanges[i].second);
+	}
+
+	//first range is loaded on this thread, the rest each get their own
+	vector<char> rangeOk(idRanges.size(),0);
+	boost::ptr_vector<FunctionRunnable> loaders;
+	boost::ptr_vector<Poco::Thread> loadThreads;
+	for (size_t i=1; i<idRanges.size(); i++)
+	{
+		Database* db = getDB();
+		char* rangeDone = &rangeOk[i];
+		auto loadFunc = boost::bind(&SqlObjDataSource::loadObjects,this,boost::cref(rangeSql[i]),i,boost::ref(rangeObjs[i]),boost::ref(rangeLoaded[i]));
+		loaders.push_back(new FunctionRunnable([db,loadFunc,rangeDone]()
+		{
+			db->threadEnter();
+			*rangeDone = loadFunc();
+			db->threadExit();
+		}));
+		loadThreads.push_back(new Poco::Thread("Object Load " + lexical_cast<string>(i)));
+		loadThreads.back().start(loaders.back());
+	}
+	rangeOk[0] = loadObjects(rangeSql[0],0,rangeObjs[0],rangeLoaded[0]);
+	for (size_t i=0; i<loadThreads.size(); i++)
+		loadThreads[i].join();
+
+	if (std::find(rangeOk.begin(),rangeOk.end(),0) != rangeOk.end())
+		return false;
+
+	//keep the ranges in order, the indexes are only filled from this thread
+	for (size_t i=0; i<rangeObjs.size(); i++)
+	{
+		indexObjects(rangeLoaded[i]);
+		std::move(rangeObjs[i].begin(),rangeObjs[i].end(),std::back_inserter(queue));
+		rangeObjs[i].clear();
+		rangeLoaded[i].clear();
+	}
+
+	UInt32 loadTime = GlobalTimer::getMSTimeDiff(startTime,GlobalTimer::getMSTime());
+	_logger.information("Loaded " + lexical_cast<string>(queue.size()) + " objects over " + lexical_cast<string>(idRanges.size()) + 
+		" connections in " + lexical_cast<string>(loadTime) + " ms");
+	return true;
 }
 void SqlObjDataSource::populateTraderObjects( int characterId, ServerObjectsQueue& queue )
 {	
 	
 	auto worldObjsRes = getDB()->queryParams("SELECT `id`, `item`, `qty`, `buy`, `sell`, `order`, `tid`, `afile` FROM `Traders_DATA` WHERE `tid`=%d", characterId);
-
+	if (!worldObjsRes)
+	{
+		_logger.error("Failed to fetch trader objects from database");
+		return;
+	}
 	while (worldObjsRes->fetchRow())
 	{
 		auto row = worldObjsRes->fields();
@@ -197,44 +594,112 @@ void SqlObjDataSource::populateTraderObjects( int characterId, ServerObjectsQueu
 		objParams.push_back(row[6].getInt32()); // tid
 		objParams.push_back(row[7].getString()); // afile
 
-		queue.push(objParams);
+		queue.push_back(std::move(objParams));
 	}
 }
 
-bool SqlObjDataSource::updateObjectInventory( int serverId, Int64 objectIdent, bool byUID, const Sqf::Value& inventory )
+void SqlObjDataSource::preferObjectId( Int64& objectIdent, bool& byUID ) const
 {
+	if (!byUID)
+		return;
+
+	Int64 objectId = _uidIndex.find(objectIdent);
+	if (objectId != 0)
+	{
+		objectIdent = objectId;
+		byUID = false;
+	}
+}
+
+bool SqlObjDataSource::updateObjectInventory( int serverId, Int64 objectIdent, bool byUID, Sqf::Value inventory )
+{
+	preferObjectId(objectIdent,byUID);
+
+	//objects that don't have their ObjectID yet aren't tracked
+	if (!byUID && !_writtenHashes.changed(objectIdent,WRITTEN_INVENTORY,PersistedHashes::Hash(inventory)))
+		return true;
+
+	//the UID can be on objects we do know the ObjectID of, whatever was written to them is overwritten now
+	if (byUID)
+	{
+		vector<Int64> objectIds = _uidIndex.findAll(objectIdent);
+		for (auto it=objectIds.cbegin(); it!=objectIds.cend(); ++it)
+			_writtenHashes.forget(*it,WRITTEN_INVENTORY);
+	}
+
 	unique_ptr<SqlStatement> stmt;
 	if (byUID)
 		stmt = getDB()->makeStatement(_stmtUpdateObjectbyUID, "UPDATE `"+_objTableName+"` SET `Inventory` = ? WHERE `ObjectUID` = ? AND `Instance` = ?");
 	else
 		stmt = getDB()->makeStatement(_stmtUpdateObjectByID, "UPDATE `"+_objTableName+"` SET `Inventory` = ? WHERE `ObjectID` = ? AND `Instance` = ?");
 
-	stmt->addString(lexical_cast<string>(inventory));
+	stmt->addDeferredString(SerializeLater(std::move(inventory)));
 	stmt->addInt64(objectIdent);
 	stmt->addInt32(serverId);
 
 	bool exRes = stmt->execute();
 	poco_assert(exRes == true);
 
+	if (!exRes && !byUID)
+		_writtenHashes.forget(objectIdent,WRITTEN_INVENTORY);
+
 	return exRes;
 }
 
 bool SqlObjDataSource::updateMoney( int money, int vaultId )
 {
-	unique_ptr<SqlStatement> stmt;
-	stmt = getDB()->makeStatement(_stmtupdateMoneyByID, "UPDATE `"+_objTableName+"` SET `Money` = ? WHERE `ObjectID` = ?");
+	//not journalled means it has to go out now
+	if (!_ledger->set(CurrencyLedger::ACCOUNT_VAULT,vaultId,money) || _flushInterval <= 0)
+		flushMoney(vaultId);
 
-	stmt->addInt32(money);
-	stmt->addInt32(vaultId);
+	return true;
+}
 
-	bool exRes = stmt->execute();
-	poco_assert(exRes == true);
+CurrencyLedger::WriteResult SqlObjDataSource::writeMoney( int vaultId, int balance, UInt64 seq )
+{
+	if (!_ledger->isJournalled())
+	{
+		auto stmt = getDB()->makeStatement(_stmtUpdateMoney, "UPDATE `"+_objTableName+"` SET `Money` = ? WHERE `ObjectID` = ?");
+		stmt->addInt32(balance);
+		stmt->addInt32(vaultId);
+		return stmt->execute() ? CurrencyLedger::WRITE_DONE : CurrencyLedger::WRITE_FAILED;
+	}
 
-	return exRes;
+	//direct, as the journal lets go of it once this returns
+	string sql = "UPDATE `" + _objTableName + "` SET `Money` = " + lexical_cast<string>(balance) + ", `MoneySeq` = " + lexical_cast<string>(seq) + 
+		" WHERE `ObjectID` = " + lexical_cast<string>(vaultId);
+	UInt64 numChanged = 0;
+	if (!getDB()->directExecute(sql.c_str(),numChanged))
+		return CurrencyLedger::WRITE_FAILED;
+
+	return (numChanged > 0) ? CurrencyLedger::WRITE_DONE : CurrencyLedger::WRITE_NO_ROW;
+}
+
+bool SqlObjDataSource::readMoneySeq( int vaultId, UInt64& seq )
+{
+	auto seqRes = getDB()->queryParams("SELECT `MoneySeq` FROM `%s` WHERE `ObjectID` = %d", _objTableName.c_str(), vaultId);
+	if (!seqRes)
+		return false;
+
+	seq = seqRes->fetchRow() ? seqRes->at(0).getUInt64() : 0;
+	return true;
+}
+
+void SqlObjDataSource::flushMoney( int vaultId )
+{
+	auto write = boost::bind(&SqlObjDataSource::writeMoney,this,_1,_2,_3);
+	auto readSeq = boost::bind(&SqlObjDataSource::readMoneySeq,this,_1,_2);
+	if (vaultId != 0)
+		_ledger->flush(CurrencyLedger::ACCOUNT_VAULT,vaultId,write,readSeq);
+	else
+		_ledger->flush(CurrencyLedger::ACCOUNT_VAULT,write,readSeq);
 }
 
 bool SqlObjDataSource::deleteObject( int serverId, Int64 objectIdent, bool byUID )
 {
+	Int64 objectUid = byUID ? objectIdent : 0;
+	preferObjectId(objectIdent,byUID);
+
 	unique_ptr<SqlStatement> stmt;
 	if (byUID)
 		stmt = getDB()->makeStatement(_stmtDeleteObjectByUID, "DELETE FROM `"+_objTableName+"` WHERE `ObjectUID` = ? AND `Instance` = ?");
@@ -247,11 +712,32 @@ bool SqlObjDataSource::deleteObject( int serverId, Int64 objectIdent, bool byUID
 	bool exRes = stmt->execute();
 	poco_assert(exRes == true);
 
+	if (!byUID)
+	{
+		//no point writing out the state of something that's gone
+		{
+			_writtenHashes.forget(objectIdent);
+			Poco::ScopedLock<Poco::FastMutex> guard(_dirtyLock);
+			_dirtyVehicles.erase(objectIdent);
+		}
+		_objGrid.remove(objectIdent);
+		_uidIndex.remove(objectIdent);
+		_ownerIndex.remove(objectIdent);
+	}
+	if (objectUid != 0)
+	{
+		_objGrid.removeByUID(objectUid);
+		_uidIndex.removeByUID(objectUid);
+		_ownerIndex.removeByUID(objectUid);
+	}
+
 	return exRes;
 }
 
 bool SqlObjDataSource::updateDatestampObject( int serverId, Int64 objectIdent, bool byUID )
 {
+	preferObjectId(objectIdent,byUID);
+
 	unique_ptr<SqlStatement> stmt;
 	if (byUID)
 		stmt = getDB()->makeStatement(_stmtUpdateDatestampObjectByUID, "UPDATE `" + _objTableName + "` SET `Datestamp` = CURRENT_TIMESTAMP, `Damage` = '0' WHERE `ObjectUID` = ? AND `Instance` = ?");
@@ -264,60 +750,372 @@ bool SqlObjDataSource::updateDatestampObject( int serverId, Int64 objectIdent, b
 	bool exRes = stmt->execute();
 	poco_assert(exRes == true);
 
+	if (!byUID)
+		resetPendingDamage(objectIdent);
+	else
+	{
+		vector<Int64> objectIds = _uidIndex.findAll(objectIdent);
+		for (auto it=objectIds.cbegin(); it!=objectIds.cend(); ++it)
+			resetPendingDamage(*it);
+	}
+
 	return exRes;
 }
 
-bool SqlObjDataSource::updateVehicleMovement( int serverId, Int64 objectIdent, const Sqf::Value& worldspace, double fuel )
+void SqlObjDataSource::resetPendingDamage( Int64 objectId )
 {
+	_writtenHashes.forget(objectId,WRITTEN_STATUS);
+
+	Poco::ScopedLock<Poco::FastMutex> guard(_dirtyLock);
+	auto it = _dirtyVehicles.find(objectId);
+	if (it != _dirtyVehicles.end())
+		it->second.damage = 0;
+}
+
+namespace { const size_t MAINTAIN_CHUNK_SIZE = 500; };
+
+bool SqlObjDataSource::updateDatestampObjects( int serverId, const vector<Int64>& objectIdents, bool byUID )
+{
+	//UIDs we know the ObjectID of go in with the IDs
+	vector<Int64> objectIds, objectUids;
+	for (auto it=objectIdents.cbegin(); it!=objectIdents.cend(); ++it)
+	{
+		Int64 objectIdent = *it;
+		bool identIsUID = byUID;
+		preferObjectId(objectIdent,identIsUID);
+		if (identIsUID)
+			objectUids.push_back(objectIdent);
+		else
+			objectIds.push_back(objectIdent);
+	}
+
+	bool exRes = true;
+	auto maintainAll = [&](const vector<Int64>& idents, const char* identColumn)
+	{
+		for (size_t chunkStart=0; chunkStart<idents.size(); chunkStart+=MAINTAIN_CHUNK_SIZE)
+		{
+			size_t chunkEnd = std::min(chunkStart+MAINTAIN_CHUNK_SIZE,idents.size());
+
+			string identList;
+			for (size_t i=chunkStart; i<chunkEnd; i++)
+			{
+				if (i > chunkStart)
+					identList += ",";
+				identList += lexical_cast<string>(idents[i]);
+			}
+
+			string query = "UPDATE `" + _objTableName + "` SET `Datestamp` = CURRENT_TIMESTAMP, `Damage` = '0' WHERE `Instance` = " + 
+				lexical_cast<string>(serverId) + " AND `" + identColumn + "` IN (" + identList + ")";
+			if (!getDB()->execute(query.c_str()))
+				exRes = false;
+		}
+	};
+	maintainAll(objectIds,"ObjectID");
+	maintainAll(objectUids,"ObjectUID");
+	poco_assert(exRes == true);
+
+	for (auto it=objectIds.cbegin(); it!=objectIds.cend(); ++it)
+		resetPendingDamage(*it);
+	for (auto it=objectUids.cbegin(); it!=objectUids.cend(); ++it)
+	{
+		vector<Int64> uidObjectIds = _uidIndex.findAll(*it);
+		for (auto idIt=uidObjectIds.cbegin(); idIt!=uidObjectIds.cend(); ++idIt)
+			resetPendingDamage(*idIt);
+	}
+
+	return exRes;
+}
+
+bool SqlObjDataSource::writeVehicleMovement( int serverId, Int64 objectId, Sqf::Value worldspace, double fuel )
+{
+	if (!_writtenHashes.changed(objectId,WRITTEN_MOVEMENT,PersistedHashes::Hash(fuel,PersistedHashes::Hash(worldspace))))
+		return true;
+
 	auto stmt = getDB()->makeStatement(_stmtUpdateVehicleMovement, "UPDATE `"+_objTableName+"` SET `Worldspace` = ? , `Fuel` = ? WHERE `ObjectID` = ?  AND `Instance` = ?");
-	stmt->addString(lexical_cast<string>(worldspace));
+	stmt->addDeferredString(SerializeLater(std::move(worldspace)));
 	stmt->addDouble(fuel);
-	stmt->addInt64(objectIdent);
+	stmt->addInt64(objectId);
 	stmt->addInt32(serverId);
 	bool exRes = stmt->execute();
 	poco_assert(exRes == true);
 
+	if (!exRes)
+		_writtenHashes.forget(objectId,WRITTEN_MOVEMENT);
+
 	return exRes;
 }
 
-bool SqlObjDataSource::updateVehicleStatus( int serverId, Int64 objectIdent, const Sqf::Value& hitPoints, double damage )
+bool SqlObjDataSource::writeVehicleStatus( int serverId, Int64 objectId, Sqf::Value hitPoints, double damage )
 {
+	if (!_writtenHashes.changed(objectId,WRITTEN_STATUS,PersistedHashes::Hash(damage,PersistedHashes::Hash(hitPoints))))
+		return true;
+
 	auto stmt = getDB()->makeStatement(_stmtUpdateVehicleStatus, "UPDATE `"+_objTableName+"` SET `Hitpoints` = ? , `Damage` = ? WHERE `ObjectID` = ? AND `Instance` = ?");
-	stmt->addString(lexical_cast<string>(hitPoints));
+	stmt->addDeferredString(SerializeLater(std::move(hitPoints)));
 	stmt->addDouble(damage);
-	stmt->addInt64(objectIdent);
+	stmt->addInt64(objectId);
 	stmt->addInt32(serverId);
 	bool exRes = stmt->execute();
 	poco_assert(exRes == true);
 
+	if (!exRes)
+		_writtenHashes.forget(objectId,WRITTEN_STATUS);
+
 	return exRes;
 }
 
-bool SqlObjDataSource::createObject( int serverId, const string& className, double damage, int characterId, 
-	const Sqf::Value& worldSpace, const Sqf::Value& inventory, const Sqf::Value& hitPoints, double fuel, Int64 uniqueId )
+bool SqlObjDataSource::updateVehicleMovement( int serverId, Int64 objectIdent, Sqf::Value worldspace, double fuel )
+{
+	double posX, posY;
+	if (WorldspacePosition(worldspace,posX,posY))
+		_objGrid.move(objectIdent,posX,posY);
+
+	if (_flushInterval <= 0)
+		return writeVehicleMovement(serverId,objectIdent,std::move(worldspace),fuel);
+
+	Poco::ScopedLock<Poco::FastMutex> guard(_dirtyLock);
+	DirtyVehicle& veh = _dirtyVehicles[objectIdent];
+	veh.serverId = serverId;
+	veh.moved = true;
+	veh.worldspace = std::move(worldspace);
+	veh.fuel = fuel;
+
+	return true;
+}
+
+bool SqlObjDataSource::updateVehicleStatus( int serverId, Int64 objectIdent, Sqf::Value hitPoints, double damage )
+{
+	if (_flushInterval <= 0)
+		return writeVehicleStatus(serverId,objectIdent,std::move(hitPoints),damage);
+
+	Poco::ScopedLock<Poco::FastMutex> guard(_dirtyLock);
+	DirtyVehicle& veh = _dirtyVehicles[objectIdent];
+	veh.serverId = serverId;
+	veh.statusChanged = true;
+	veh.hitPoints = std::move(hitPoints);
+	veh.damage = damage;
+
+	return true;
+}
+
+bool SqlObjDataSource::leaseIdBlock()
+{
+	//compare and swap, so hives sharing the table never get the same block
+	for (int attempt=0; attempt<5; attempt++)
+	{
+		UInt64 oldNext;
+		{
+			auto seqRes = getDB()->queryParams("SELECT `NextID` FROM `Object_SEQUENCE` WHERE `Name` = '%s'", _objTableName.c_str());
+			if (!seqRes)
+				return false;
+
+			if (!seqRes->fetchRow())
+			{
+				//first lease for this table, another hive making the row at the same time is fine too
+				getDB()->directExecuteParams("INSERT INTO `Object_SEQUENCE` (`Name`, `NextID`) VALUES ('%s', 1)", _objTableName.c_str());
+				continue;
+			}
+
+			oldNext = seqRes->at(0).getUInt64();
+		}
+
+		//never below what's already in the table, in case something inserted without going through here
+		UInt64 blockStart = oldNext;
+		{
+			auto maxRes = getDB()->queryParams("SELECT COALESCE(MAX(`ObjectID`),0) FROM `%s`", _objTableName.c_str());
+			if (!maxRes || !maxRes->fetchRow())
+				return false;
+
+			UInt64 maxId = maxRes->at(0).getUInt64();
+			if (maxId >= blockStart)
+				blockStart = maxId+1;
+		}
+
+		UInt64 blockEnd = blockStart + static_cast<UInt64>(_idBlockSize);
+		string leaseSql = "UPDATE `Object_SEQUENCE` SET `NextID` = " + lexical_cast<string>(blockEnd) + 
+			" WHERE `Name` = '" + _objTableName + "' AND `NextID` = " + lexical_cast<string>(oldNext);
+		UInt64 numLeased = 0;
+		if (!getDB()->directExecute(leaseSql.c_str(),numLeased))
+			return false;
+
+		//0 if someone else got there first
+		if (numLeased != 1)
+			continue;
+
+		{
+			Poco::ScopedLock<Poco::FastMutex> guard(_leaseLock);
+			_spareStart = static_cast<Int64>(blockStart);
+			_spareEnd = static_cast<Int64>(blockEnd);
+			_leasePending = false;
+		}
+		_leaseReady.set();
+		_logger.debug("Leased ObjectIDs " + lexical_cast<string>(blockStart) + " to " + lexical_cast<string>(blockEnd-1));
+		return true;
+	}
+
+	return false;
+}
+
+namespace
+{
+	const long LEASE_RETRY_DELAY = 30000;
+	//how long publishing an object waits for a block once the leased ones ran out
+	const long LEASE_WAIT_TIME = 2000;
+};
+
+void SqlObjDataSource::leaseIdBlocks()
+{
+	getDB()->threadEnter();
+	while (!_leaseStop)
+	{
+		_leaseWanted.wait();
+		if (_leaseStop)
+			break;
+
+		//new objects can't be published until this works out
+		while (!leaseIdBlock())
+		{
+			_logger.warning("Failed to lease ObjectIDs from Object_SEQUENCE, trying again in " + lexical_cast<string>(LEASE_RETRY_DELAY/1000) + " seconds");
+			_leaseWanted.tryWait(LEASE_RETRY_DELAY);
+			if (_leaseStop)
+				break;
+		}
+	}
+	getDB()->threadExit();
+}
+
+Int64 SqlObjDataSource::nextObjectId()
+{
+	Poco::Timestamp waitStart;
+	for (;;)
+	{
+		{
+			Poco::ScopedLock<Poco::FastMutex> guard(_leaseLock);
+			if (_nextLeasedId >= _leaseEnd && _spareStart < _spareEnd)
+			{
+				_nextLeasedId = _spareStart;
+				_leaseEnd = _spareEnd;
+				_spareStart = _spareEnd = 0;
+			}
+
+			if (_nextLeasedId < _leaseEnd)
+			{
+				Int64 objectId = _nextLeasedId++;
+
+				//half of it gone, get the next one ready
+				if (_spareStart >= _spareEnd && !_leasePending && (_leaseEnd - _nextLeasedId) * 2 <= static_cast<Int64>(_idBlockSize))
+				{
+					_leasePending = true;
+					_leaseWanted.set();
+				}
+
+				return objectId;
+			}
+
+			//the next block didn't make it in time
+			if (!_leasePending)
+			{
+				_leasePending = true;
+				_leaseWanted.set();
+			}
+		}
+
+		long waitLeft = LEASE_WAIT_TIME - static_cast<long>(waitStart.elapsed()/1000);
+		if (waitLeft <= 0 || !_leaseReady.tryWait(waitLeft))
+			return 0;
+	}
+}
+
+Sqf::Value SqlObjDataSource::createObject( int serverId, const string& className, double damage, int characterId, 
+	Sqf::Value worldSpace, Sqf::Value inventory, Sqf::Value hitPoints, double fuel, Int64 uniqueId )
 {
-	auto stmt = getDB()->makeStatement(_stmtCreateObject, 
-		"INSERT INTO `"+_objTableName+"` (`ObjectUID`, `Instance`, `Classname`, `Damage`, `CharacterID`, `Worldspace`, `Inventory`, `Hitpoints`, `Fuel`, `Datestamp`) "
-		"VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, CURRENT_TIMESTAMP)");
+	//leased IDs are never mixed with AUTO_INCREMENT ones, which could land inside a leased block
+	Int64 objectId = 0;
+	if (_idBlockSize > 0)
+	{
+		objectId = nextObjectId();
+		if (objectId == 0)
+		{
+			_logger.error("No ObjectID could be leased in time for new " + className);
+
+			Sqf::Parameters retVal;
+			retVal.push_back(string("ERROR"));
+			return retVal;
+		}
+	}
+
+	//before the worldspace is handed over to the writer thread
+	double posX, posY;
+	bool hasPos = WorldspacePosition(worldSpace,posX,posY);
+
+	unique_ptr<SqlStatement> stmt;
+	if (objectId != 0)
+	{
+		stmt = getDB()->makeStatement(_stmtCreateObjectWithID, 
+			"INSERT INTO `"+_objTableName+"` (`ObjectID`, `ObjectUID`, `Instance`, `Classname`, `Damage`, `CharacterID`, `Worldspace`, `Inventory`, `Hitpoints`, `Fuel`, `Datestamp`) "
+			"VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, CURRENT_TIMESTAMP)");
+		stmt->addInt64(objectId);
+	}
+	else
+	{
+		stmt = getDB()->makeStatement(_stmtCreateObject, 
+			"INSERT INTO `"+_objTableName+"` (`ObjectUID`, `Instance`, `Classname`, `Damage`, `CharacterID`, `Worldspace`, `Inventory`, `Hitpoints`, `Fuel`, `Datestamp`) "
+			"VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, CURRENT_TIMESTAMP)");
+	}
 
 	stmt->addInt64(uniqueId);
 	stmt->addInt32(serverId);
 	stmt->addString(className);
 	stmt->addDouble(damage);
 	stmt->addInt32(characterId);
-	stmt->addString(lexical_cast<string>(worldSpace));
-	stmt->addString(lexical_cast<string>(inventory));
-	stmt->addString(lexical_cast<string>(hitPoints));
+	stmt->addDeferredString(SerializeLater(std::move(worldSpace)));
+	stmt->addDeferredString(SerializeLater(std::move(inventory)));
+	stmt->addDeferredString(SerializeLater(std::move(hitPoints)));
 	stmt->addDouble(fuel);
 	bool exRes = stmt->execute();
 	poco_assert(exRes == true);
 
-	return exRes;
+	Sqf::Parameters retVal;
+	if (!exRes)
+	{
+		retVal.push_back(string("ERROR"));
+		return retVal;
+	}
+
+	retVal.push_back(string("PASS"));
+	if (objectId != 0)
+	{
+		_uidIndex.insert(uniqueId,objectId);
+		_ownerIndex.insert(characterId,objectId,uniqueId);
+		if (hasPos)
+			_objGrid.insert(objectId,uniqueId,className,posX,posY);
+
+		retVal.push_back(lexical_cast<string>(objectId)); //objectId should be stringified
+	}
+	else
+	{
+		//the ObjectID isn't known until it's asked for (by UID)
+		_uidIndex.insertPending(uniqueId);
+		_ownerIndex.insertPending(characterId,uniqueId);
+		if (uniqueId != 0 && hasPos)
+			_objGrid.insertPending(uniqueId,className,posX,posY);
+	}
+
+	return retVal;
 }
 
 Sqf::Value SqlObjDataSource::fetchObjectId( int serverId, Int64 objectIdent )
 {
 	Sqf::Parameters retVal;
+
+	Int64 knownId = _uidIndex.find(objectIdent);
+	if (knownId != 0)
+	{
+		retVal.push_back(string("PASS"));
+		retVal.push_back(lexical_cast<string>(knownId));
+		return retVal;
+	}
+
 	//get details from db
 	auto worldObjsRes = getDB()->queryParams("SELECT `ObjectID` FROM `%s` WHERE `Instance` = %d AND `ObjectUID` = %" PRIu64 "", _objTableName.c_str(), serverId, objectIdent);
 
@@ -329,6 +1127,10 @@ Sqf::Value SqlObjDataSource::fetchObjectId( int serverId, Int64 objectIdent )
 
 		if (objectid != 0)
 		{
+			_uidIndex.insert(objectIdent,objectid);
+			_objGrid.resolvePending(objectIdent,objectid);
+			_ownerIndex.resolvePending(objectIdent,objectid);
+
 			retVal.push_back(string("PASS"));
 			retVal.push_back(lexical_cast<string>(objectid));
 		}
@@ -343,4 +1145,37 @@ Sqf::Value SqlObjDataSource::fetchObjectId( int serverId, Int64 objectIdent )
 	}
 
 	return retVal;
-}
\ No newline at end of file
+}
+
+Sqf::Value SqlObjDataSource::fetchObjectsNear( double x, double y, double radius )
+{
+	Sqf::Parameters nearObjects;
+	auto matches = _objGrid.queryRadius(x,y,radius);
+	for (auto it=matches.cbegin(); it!=matches.cend(); ++it)
+	{
+		Sqf::Parameters objInfo;
+		objInfo.push_back(lexical_cast<string>(it->objectId)); //objectId should be stringified
+		objInfo.push_back(it->className);
+		nearObjects.push_back(std::move(objInfo));
+	}
+
+	Sqf::Parameters retVal;
+	retVal.push_back(string("PASS"));
+	retVal.push_back(std::move(nearObjects));
+	return retVal;
+}
+Sqf::Value SqlObjDataSource::fetchOwnedObjects( int characterId )
+{
+	size_t numPending = 0;
+	vector<Int64> objectIds = _ownerIndex.find(characterId,numPending);
+
+	Sqf::Parameters idList;
+	for (auto it=objectIds.cbegin(); it!=objectIds.cend(); ++it)
+		idList.push_back(lexical_cast<string>(*it)); //objectId should be stringified
+
+	Sqf::Parameters retVal;
+	retVal.push_back(string("PASS"));
+	retVal.push_back(static_cast<int>(objectIds.size()+numPending));
+	retVal.push_back(std::move(idList));
+	return retVal;
+}
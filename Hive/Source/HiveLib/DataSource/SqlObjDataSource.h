@@ -20,38 +20,144 @@
 
 #include "SqlDataSource.h"
 #include "ObjDataSource.h"
+#include "ObjectGrid.h"
+#include "ObjectUIDIndex.h"
+#include "ObjectOwnerIndex.h"
+#include "PersistedHashes.h"
+#include "CurrencyLedger.h"
 #include "Database/SqlStatement.h"
 
+#include <Poco/Thread.h>
+#include <Poco/Event.h>
+#include <Poco/RunnableAdapter.h>
+#include <Poco/Timer.h>
+#include <Poco/Mutex.h>
+
 namespace Poco { namespace Util { class AbstractConfiguration; }; };
 class SqlObjDataSource : public SqlDataSource, public ObjDataSource
 {
 public:
-	SqlObjDataSource(Poco::Logger& logger, shared_ptr<Database> db, const Poco::Util::AbstractConfiguration* conf);
-	~SqlObjDataSource() {}
+	SqlObjDataSource(Poco::Logger& logger, shared_ptr<Database> db, const Poco::Util::AbstractConfiguration* conf, shared_ptr<CurrencyLedger> ledger);
+	~SqlObjDataSource();
 
-	void populateObjects( int serverId, ServerObjectsQueue& queue ) override;
+	bool populateObjects( int serverId, ServerObjectsQueue& queue ) override;
 
 	void populateTraderObjects( int characterId, ServerObjectsQueue& queue ) override;
 
-	bool updateObjectInventory( int serverId, Int64 objectIdent, bool byUID, const Sqf::Value& inventory ) override;
+	bool updateObjectInventory( int serverId, Int64 objectIdent, bool byUID, Sqf::Value inventory ) override;
 	bool deleteObject( int serverId, Int64 objectIdent, bool byUID ) override;
 	bool updateMoney( int money, int vaultId ) override;
 	bool updateDatestampObject( int serverId, Int64 objectIdent, bool byUID ) override;
-	bool updateVehicleMovement( int serverId, Int64 objectIdent, const Sqf::Value& worldspace, double fuel ) override;
-	bool updateVehicleStatus( int serverId, Int64 objectIdent, const Sqf::Value& hitPoints, double damage ) override;
-	bool createObject( int serverId, const string& className, double damage, int characterId, 
-		const Sqf::Value& worldSpace, const Sqf::Value& inventory, const Sqf::Value& hitPoints, double fuel, Int64 uniqueId ) override;
+	bool updateDatestampObjects( int serverId, const vector<Int64>& objectIdents, bool byUID ) override;
+	bool updateVehicleMovement( int serverId, Int64 objectIdent, Sqf::Value worldspace, double fuel ) override;
+	bool updateVehicleStatus( int serverId, Int64 objectIdent, Sqf::Value hitPoints, double damage ) override;
+	Sqf::Value createObject( int serverId, const string& className, double damage, int characterId, 
+		Sqf::Value worldSpace, Sqf::Value inventory, Sqf::Value hitPoints, double fuel, Int64 uniqueId ) override;
 	Sqf::Value fetchObjectId( int serverId, Int64 objectIdent ) override;
+	Sqf::Value fetchObjectsNear( double x, double y, double radius ) override;
+	Sqf::Value fetchOwnedObjects( int characterId ) override;
 private:
 	string _objTableName;
 	int _cleanupPlacedDays;
 	bool _vehicleOOBReset;
 
+	//what the indexes need to know about a loaded object
+	struct LoadedObject
+	{
+		Int64 objectId;
+		Int64 objectUid;
+		int ownerId;
+		string className;
+		bool hasPos;
+		double posX, posY;
+	};
+	typedef vector<LoadedObject> LoadedObjects;
+	//loads the objects matching whereSql into queue and loaded over the connIdx-th connection, false if the query failed or broke off
+	//doesn't touch the indexes, so it can run on several threads at once
+	bool loadObjects( const string& whereSql, size_t connIdx, ServerObjectsQueue& queue, LoadedObjects& loaded );
+	void indexObjects( const LoadedObjects& loaded );
+	//splits the load into ObjectID ranges if there's more than one load connection
+	bool loadObjectRanges( const string& whereSql, ServerObjectsQueue& queue );
+	//number of connections the objects are loaded over in parallel
+	int _loadConnections;
+
+	//old placed objects are deleted in chunks on a separate thread, so the object load doesn't wait for it
+	void cleanupPlacedObjects();
+	int _cleanupChunkSize;
+	string _cleanupSql;
+	Poco::RunnableAdapter<SqlObjDataSource> _cleanupRunner;
+	Poco::Thread _cleanupThread;
+	Poco::Event _cleanupStop;
+
+	//vehicle movement and status only keep the latest values, which get written out every _flushInterval ms
+	struct DirtyVehicle
+	{
+		DirtyVehicle() : serverId(0), moved(false), fuel(0), statusChanged(false), damage(0) {}
+
+		int serverId;
+		bool moved;
+		Sqf::Value worldspace;	//turned into text by the flush, not the game thread
+		double fuel;
+		bool statusChanged;
+		Sqf::Value hitPoints;
+		double damage;
+	};
+	typedef map<Int64,DirtyVehicle> DirtyVehicleMap;
+	DirtyVehicleMap _dirtyVehicles;
+	Poco::FastMutex _dirtyLock;
+	long _flushInterval;
+	Poco::Timer _flushTimer;
+
+	void onFlushTimer(Poco::Timer& timer);
+	void flushVehicles();
+	bool writeVehicleMovement( int serverId, Int64 objectId, Sqf::Value worldspace, double fuel );
+	bool writeVehicleStatus( int serverId, Int64 objectId, Sqf::Value hitPoints, double damage );
+
+	//vault money (600) goes through the ledger, and out with the vehicles
+	shared_ptr<CurrencyLedger> _ledger;
+	CurrencyLedger::WriteResult writeMoney( int vaultId, int balance, UInt64 seq );
+	bool readMoneySeq( int vaultId, UInt64& seq );
+	void flushMoney( int vaultId = 0 );
+
+	//what was last written for each object, by ObjectID
+	PersistedHashes _writtenHashes;
+
+	//positions of all the objects in the instance
+	ObjectGrid _objGrid;
+
+	//by-UID requests are turned into by-ID ones when the UID is known
+	ObjectUIDIndex _uidIndex;
+	void preferObjectId( Int64& objectIdent, bool& byUID ) const;
+
+	//objects of each CharacterID, so owner lookups don't need the database
+	ObjectOwnerIndex _ownerIndex;
+
+	//maintenance resets the damage, so a pending damage write mustn't undo that
+	void resetPendingDamage( Int64 objectId );
+
+	//ObjectIDs for new objects are handed out from blocks reserved in Object_SEQUENCE, 0 block size turns that off
+	//the next block is leased on its own thread once half of the current one is used up
+	int _idBlockSize;
+	Int64 _nextLeasedId;
+	Int64 _leaseEnd;
+	Int64 _spareStart;
+	Int64 _spareEnd;
+	bool _leasePending;
+	Poco::FastMutex _leaseLock;
+	//leases into the spare block, false if the database wouldn't give one out
+	bool leaseIdBlock();
+	void leaseIdBlocks();
+	Poco::RunnableAdapter<SqlObjDataSource> _leaseRunner;
+	Poco::Thread _leaseThread;
+	Poco::Event _leaseWanted;
+	Poco::Event _leaseReady;
+	volatile bool _leaseStop;
+	//waits a bit for the next block if they ran out, 0 if none came in time
+	Int64 nextObjectId();
+
 	//statement ids
-	SqlStatementID _stmtDeleteOldObject;
 	SqlStatementID _stmtUpdateObjectbyUID;
 	SqlStatementID _stmtUpdateObjectByID;
-	SqlStatementID _stmtupdateMoneyByID;
 	SqlStatementID _stmtDeleteObjectByUID;
 	SqlStatementID _stmtDeleteObjectByID;
 	SqlStatementID _stmtUpdateDatestampObjectByUID;
@@ -59,4 +165,6 @@ private:
 	SqlStatementID _stmtUpdateVehicleMovement;
 	SqlStatementID _stmtUpdateVehicleStatus;
 	SqlStatementID _stmtCreateObject;
+	SqlStatementID _stmtCreateObjectWithID;
+	SqlStatementID _stmtUpdateMoney;
 };
\ No newline at end of file
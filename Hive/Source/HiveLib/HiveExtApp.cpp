@@ -20,6 +20,7 @@
 
 #include <boost/bind.hpp>
 #include <boost/optional.hpp>
+#include <Poco/Format.h>
 
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/algorithm/string/trim.hpp>
@@ -123,13 +124,18 @@ HiveExtApp::HiveExtApp(string suffixDir) : AppServer("HiveExt",suffixDir), _serv
 	handlers[305] = boost::bind(&HiveExtApp::vehicleMoved,this,_1);
 	handlers[306] = boost::bind(&HiveExtApp::vehicleDamaged,this,_1);
 	handlers[307] = boost::bind(&HiveExtApp::getDateTime,this,_1);
-	handlers[308] = boost::bind(&HiveExtApp::objectPublish,this,_1);
+	handlers[308] = boost::bind(&HiveExtApp::objectPublish,this,_1);		//Returns the new ObjectID too, if ObjectIDs are leased
 
+	// Closes a stream started by 302, 399, 104 or 999 before reading all of it
+	handlers[390] = boost::bind(&HiveExtApp::streamCancel,this,_1);
 	// Custom to just return db ID for object UID
 	handlers[388] = boost::bind(&HiveExtApp::objectReturnId,this,_1);
 	// for maintain 
 	handlers[396] = boost::bind(&HiveExtApp::datestampObjectUpdate,this,_1,false);
 	handlers[397] = boost::bind(&HiveExtApp::datestampObjectUpdate,this,_1,true);
+	// maintain a whole array of objects at once
+	handlers[394] = boost::bind(&HiveExtApp::datestampObjectsUpdate,this,_1,false);
+	handlers[395] = boost::bind(&HiveExtApp::datestampObjectsUpdate,this,_1,true);
 	// For traders 
 	handlers[398] = boost::bind(&HiveExtApp::tradeObject,this,_1);
 	handlers[399] = boost::bind(&HiveExtApp::loadTraderDetails,this,_1);
@@ -137,12 +143,16 @@ HiveExtApp::HiveExtApp(string suffixDir) : AppServer("HiveExt",suffixDir), _serv
 
 	handlers[309] = boost::bind(&HiveExtApp::objectInventory,this,_1,true);
 	handlers[310] = boost::bind(&HiveExtApp::objectDelete,this,_1,true);
+	handlers[311] = boost::bind(&HiveExtApp::objectsNear,this,_1);			//Returns [ObjectID,Classname] of objects within radius of position
+	handlers[312] = boost::bind(&HiveExtApp::objectsOwned,this,_1);			//Returns count and ObjectIDs of the objects owned by a CharacterID
 	handlers[400] = boost::bind(&HiveExtApp::serverShutdown,this,_1);
+	handlers[401] = boost::bind(&HiveExtApp::databaseStatus,this,_1);		//Returns seconds the database has been unreachable, and writes waiting for it
 	//player/character loads
 	handlers[100] = boost::bind(&HiveExtApp::loadCharacters, this, _1);
 	handlers[101] = boost::bind(&HiveExtApp::loadPlayer,this,_1);
 	handlers[102] = boost::bind(&HiveExtApp::loadCharacterDetails,this,_1);
 	handlers[103] = boost::bind(&HiveExtApp::recordCharacterLogin,this,_1);
+	handlers[104] = boost::bind(&HiveExtApp::streamCharacterDetails,this,_1);	//102 for a whole array of CharacterIDs, streamed a few characters per row
 	//character updates
 	handlers[201] = boost::bind(&HiveExtApp::playerUpdate,this,_1);
 	handlers[202] = boost::bind(&HiveExtApp::playerDeath,this,_1);
@@ -199,13 +209,16 @@ void HiveExtApp::callExtension( const char* function, char* output, size_t outpu
 	if (logger().debug())
 		logger().debug("Original params: |" + string(function) + "|");
 
-	logger().information("Method: " + lexical_cast<string>(funcNum) + " Params: " + lexical_cast<string>(params));
+	if (logger().information())
+		logger().information("Method: " + lexical_cast<string>(funcNum) + " Params: " + lexical_cast<string>(params));
+
 	HandlerFunc handler = handlers[funcNum];
 	Sqf::Value res;
 	boost::optional<ServerShutdownException> shutdownExc;
+	Poco::Timestamp callStart;
 	try
 	{
-		res = handler(params);
+		res = handler(std::move(params));
 	}
 	catch (const ServerShutdownException& e)
 	{
@@ -222,7 +235,8 @@ void HiveExtApp::callExtension( const char* function, char* output, size_t outpu
 	{
 		logger().error("Error executing |" + string(function) + "|");
 		return;
-	}		
+	}
+	recordTiming(funcNum,callStart.elapsed());
 
 	string serializedRes = lexical_cast<string>(res);
 	logger().information("Result: " + serializedRes);
@@ -233,7 +247,35 @@ void HiveExtApp::callExtension( const char* function, char* output, size_t outpu
 		strncpy_s(output,outputSize,serializedRes.c_str(),outputSize-1);
 
 	if (shutdownExc.is_initialized())
+	{
+		logTimings();
 		throw *shutdownExc;
+	}
+}
+
+void HiveExtApp::recordTiming(int funcNum, Poco::Timestamp::TimeDiff elapsed)
+{
+	MethodTiming& timing = _timings[funcNum];
+	timing.calls++;
+	timing.total += elapsed;
+	if (elapsed > timing.longest)
+		timing.longest = elapsed;
+
+	if (logger().debug())
+		logger().debug(Poco::format("Method %d took %?d us",funcNum,elapsed));
+}
+
+void HiveExtApp::logTimings()
+{
+	for (auto it=_timings.cbegin(); it!=_timings.cend(); ++it)
+	{
+		const MethodTiming& timing = it->second;
+		if (timing.calls < 1)
+			continue;
+
+		logger().information(Poco::format("Method %d: %?u calls, avg %?d us, max %?d us",
+			it->first,timing.calls,timing.total/static_cast<Poco::Int64>(timing.calls),timing.longest));
+	}
 }
 
 namespace
@@ -296,47 +338,87 @@ Sqf::Value HiveExtApp::getDateTime( Sqf::Parameters params )
 #include "DataSource/ObjDataSource.h"
 #include <Poco/RandomStream.h>
 
+Sqf::Value HiveExtApp::streamRow( const string& token )
+{
+	Sqf::Parameters row;
+	StreamCursors::FetchResult fetchRes = _cursors.fetch(token,row);
+	if (fetchRes == StreamCursors::FETCH_ROW)
+		return row;
+	else if (fetchRes == StreamCursors::FETCH_END)
+		return ReturnStatus("NOMORE");
+	else
+		return ReturnStatus("ERROR",string("Unknown stream token"));
+}
+
+bool HiveExtApp::legacyStreamRow( string& token, Sqf::Value& outRow )
+{
+	if (token.length() < 1)
+		return false;
+
+	Sqf::Parameters row;
+	if (_cursors.fetch(token,row) == StreamCursors::FETCH_ROW)
+	{
+		outRow = std::move(row);
+		return true;
+	}
+
+	//that stream is done, next call will start a new one
+	token.clear();
+	return false;
+}
+
+Sqf::Value HiveExtApp::streamCancel( Sqf::Parameters params )
+{
+	string token = Sqf::GetStringAny(params.at(0));
+	return ReturnBooleanStatus(_cursors.close(token));
+}
+
 Sqf::Value HiveExtApp::streamObjects( Sqf::Parameters params )
 {
-	if (_srvObjects.empty())
+	if (params.size() > 1)
+		return streamRow(Sqf::GetStringAny(params.at(1)));
+
+	Sqf::Value legacyRow;
+	if (legacyStreamRow(_legacyObjCursor,legacyRow))
+		return legacyRow;
+
+	if (_initKey.length() < 1)
 	{
-		if (_initKey.length() < 1)
-		{
-			int serverId = boost::get<int>(params.at(0));
-			setServerId(serverId);
+		int serverId = boost::get<int>(params.at(0));
+		setServerId(serverId);
 
-			_objData->populateObjects(getServerId(), _srvObjects);
-			//set up initKey
-			{
-				boost::array<UInt8,16> keyData;
-				Poco::RandomInputStream().read((char*)keyData.c_array(),keyData.size());
-				std::ostringstream ostr;
-				Poco::HexBinaryEncoder enc(ostr);
-				enc.rdbuf()->setLineLength(0);
-				enc.write((const char*)keyData.data(),keyData.size());
-				enc.close();
-				_initKey = ostr.str();
-			}
+		auto srvObjects = make_shared<StreamCursors::Rows>();
+		//leaves _initKey empty, so the server can ask again
+		if (!_objData->populateObjects(getServerId(), *srvObjects))
+			return ReturnStatus("ERROR",string("Failed to load objects"));
 
-			Sqf::Parameters retVal;
-			retVal.push_back(string("ObjectStreamStart"));
-			retVal.push_back(static_cast<int>(_srvObjects.size()));
-			retVal.push_back(_initKey);
-			return retVal;
-		}
-		else
+		//set up initKey
 		{
-			Sqf::Parameters retVal;
-			retVal.push_back(string("ERROR"));
-			retVal.push_back(string("Instance already initialized"));
-			return retVal;
+			boost::array<UInt8,16> keyData;
+			Poco::RandomInputStream().read((char*)keyData.c_array(),keyData.size());
+			std::ostringstream ostr;
+			Poco::HexBinaryEncoder enc(ostr);
+			enc.rdbuf()->setLineLength(0);
+			enc.write((const char*)keyData.data(),keyData.size());
+			enc.close();
+			_initKey = ostr.str();
 		}
+
+		int numObjects = static_cast<int>(srvObjects->size());
+		_legacyObjCursor = _cursors.open(srvObjects);
+
+		Sqf::Parameters retVal;
+		retVal.push_back(string("ObjectStreamStart"));
+		retVal.push_back(numObjects);
+		retVal.push_back(_initKey);
+		retVal.push_back(_legacyObjCursor);
+		return retVal;
 	}
 	else
 	{
-		Sqf::Parameters retVal = _srvObjects.front();
-		_srvObjects.pop();
-
+		Sqf::Parameters retVal;
+		retVal.push_back(string("ERROR"));
+		retVal.push_back(string("Instance already initialized"));
 		return retVal;
 	}
 }
@@ -355,10 +437,10 @@ Sqf::Value HiveExtApp::Money( Sqf::Parameters params )
 Sqf::Value HiveExtApp::objectInventory( Sqf::Parameters params, bool byUID /*= false*/ )
 {
 	Int64 objectIdent = Sqf::GetBigInt(params.at(0));
-	Sqf::Value inventory = boost::get<Sqf::Parameters>(params.at(1));
+	Sqf::Value inventory = std::move(boost::get<Sqf::Parameters>(params.at(1)));
 
 	if (objectIdent != 0) //all the vehicles have objectUID = 0, so it would be bad to update those
-		return ReturnBooleanStatus(_objData->updateObjectInventory(getServerId(),objectIdent,byUID,inventory));
+		return ReturnBooleanStatus(_objData->updateObjectInventory(getServerId(),objectIdent,byUID,std::move(inventory)));
 
 	return ReturnBooleanStatus(true);
 }
@@ -383,14 +465,33 @@ Sqf::Value HiveExtApp::datestampObjectUpdate(Sqf::Parameters params, bool byUID
 	return ReturnBooleanStatus(true);
 }
 
+Sqf::Value HiveExtApp::datestampObjectsUpdate(Sqf::Parameters params, bool byUID /*= false*/)
+{
+	Sqf::Parameters idents = boost::get<Sqf::Parameters>(params.at(0));
+
+	vector<Int64> objectIdents;
+	objectIdents.reserve(idents.size());
+	for (auto it=idents.cbegin(); it!=idents.cend(); ++it)
+	{
+		Int64 objectIdent = Sqf::GetBigInt(*it);
+		if (objectIdent != 0) //same as above
+			objectIdents.push_back(objectIdent);
+	}
+
+	if (objectIdents.empty())
+		return ReturnBooleanStatus(true);
+
+	return ReturnBooleanStatus(_objData->updateDatestampObjects(getServerId(), objectIdents, byUID));
+}
+
 Sqf::Value HiveExtApp::vehicleMoved( Sqf::Parameters params )
 {
 	Int64 objectIdent = Sqf::GetBigInt(params.at(0));
-	Sqf::Value worldspace = boost::get<Sqf::Parameters>(params.at(1));
+	Sqf::Value worldspace = std::move(boost::get<Sqf::Parameters>(params.at(1)));
 	double fuel = Sqf::GetDouble(params.at(2));
 
 	if (objectIdent > 0) //sometimes script sends this with object id 0, which is bad
-		return ReturnBooleanStatus(_objData->updateVehicleMovement(getServerId(),objectIdent,worldspace,fuel));
+		return ReturnBooleanStatus(_objData->updateVehicleMovement(getServerId(),objectIdent,std::move(worldspace),fuel));
 
 	return ReturnBooleanStatus(true);
 }
@@ -398,11 +499,11 @@ Sqf::Value HiveExtApp::vehicleMoved( Sqf::Parameters params )
 Sqf::Value HiveExtApp::vehicleDamaged( Sqf::Parameters params )
 {
 	Int64 objectIdent = Sqf::GetBigInt(params.at(0));
-	Sqf::Value hitPoints = boost::get<Sqf::Parameters>(params.at(1));
+	Sqf::Value hitPoints = std::move(boost::get<Sqf::Parameters>(params.at(1)));
 	double damage = Sqf::GetDouble(params.at(2));
 
 	if (objectIdent > 0) //sometimes script sends this with object id 0, which is bad
-		return ReturnBooleanStatus(_objData->updateVehicleStatus(getServerId(),objectIdent,hitPoints,damage));
+		return ReturnBooleanStatus(_objData->updateVehicleStatus(getServerId(),objectIdent,std::move(hitPoints),damage));
 
 	return ReturnBooleanStatus(true);
 }
@@ -418,7 +519,7 @@ Sqf::Value HiveExtApp::objectPublish( Sqf::Parameters params )
 	double fuel = Sqf::GetDouble(params.at(7));
 	Int64 uniqueId = Sqf::GetBigInt(params.at(8));
 
-	return ReturnBooleanStatus(_objData->createObject(getServerId(),className,damage,characterId,worldSpace,inventory,hitPoints,fuel,uniqueId));
+	return _objData->createObject(getServerId(),className,damage,characterId,std::move(worldSpace),std::move(inventory),std::move(hitPoints),fuel,uniqueId);
 }
 
 Sqf::Value HiveExtApp::objectReturnId( Sqf::Parameters params )
@@ -427,6 +528,23 @@ Sqf::Value HiveExtApp::objectReturnId( Sqf::Parameters params )
 	return _objData->fetchObjectId(getServerId(),ObjectUID);
 }
 
+Sqf::Value HiveExtApp::objectsNear( Sqf::Parameters params )
+{
+	Sqf::Parameters position = boost::get<Sqf::Parameters>(params.at(0));
+	double x = Sqf::GetDouble(position.at(0));
+	double y = Sqf::GetDouble(position.at(1));
+	double radius = Sqf::GetDouble(params.at(1));
+
+	return _objData->fetchObjectsNear(x,y,radius);
+}
+
+Sqf::Value HiveExtApp::objectsOwned( Sqf::Parameters params )
+{
+	int characterId = Sqf::GetIntAny(params.at(0));
+
+	return _objData->fetchOwnedObjects(characterId);
+}
+
 #include "DataSource/CharDataSource.h"
 
 Sqf::Value HiveExtApp::loadCharacters( Sqf::Parameters params )
@@ -452,26 +570,88 @@ Sqf::Value HiveExtApp::loadCharacterDetails( Sqf::Parameters params )
 	return _charData->fetchCharacterDetails(characterId);
 }
 
-Sqf::Value HiveExtApp::loadTraderDetails( Sqf::Parameters params )
+namespace
 {
-	if (_srvObjects.empty())
-	{
-		int characterId = Sqf::GetIntAny(params.at(0));
+	//serialized length of the characters in one row of a 104 stream, the output buffer of the game is 4096 bytes
+	const size_t DETAILS_ROW_LENGTH = 4000;
+};
 
-		_objData->populateTraderObjects(characterId, _srvObjects);
+Sqf::Value HiveExtApp::streamCharacterDetails( Sqf::Parameters params )
+{
+	if (params.size() > 1)
+		return streamRow(Sqf::GetStringAny(params.at(1)));
 
-		Sqf::Parameters retVal;
-		retVal.push_back(string("ObjectStreamStart"));
-		retVal.push_back(static_cast<int>(_srvObjects.size()));
-		return retVal;
+	Sqf::Parameters idsArr = boost::get<Sqf::Parameters>(params.at(0));
+
+	vector<int> characterIds;
+	characterIds.reserve(idsArr.size());
+	for (auto it=idsArr.cbegin(); it!=idsArr.cend(); ++it)
+		characterIds.push_back(Sqf::GetIntAny(*it));
+
+	CharDataSource::DetailsQueue details;
+	_charData->fetchCharacterDetailsBulk(characterIds,details);
+
+	//as many characters per row as fit in the output, a row always has at least one
+	auto detailRows = make_shared<StreamCursors::Rows>();
+	size_t rowLength = 0;
+	for (auto it=details.begin(); it!=details.end(); ++it)
+	{
+		size_t entryLength = Sqf::SerializedLength(*it) + 1;
+		if (detailRows->empty() || rowLength + entryLength > DETAILS_ROW_LENGTH)
+		{
+			detailRows->push_back(Sqf::Parameters());
+			rowLength = 2;
+		}
+		detailRows->back().push_back(std::move(*it));
+		rowLength += entryLength;
 	}
-	else
+
+	Sqf::Parameters retVal;
+	retVal.push_back(string("DetailsStreamStart"));
+	retVal.push_back(static_cast<int>(details.size()));
+	retVal.push_back(static_cast<int>(detailRows->size()));
+	retVal.push_back(_cursors.open(detailRows));
+
+	return retVal;
+}
+
+Sqf::Value HiveExtApp::loadTraderDetails( Sqf::Parameters params )
+{
+	if (params.size() > 1)
+		return streamRow(Sqf::GetStringAny(params.at(1)));
+
+	int characterId = Sqf::GetIntAny(params.at(0));
+
+	Sqf::Value legacyRow;
+	if (legacyStreamRow(_legacyTraderCursors[characterId],legacyRow))
+		return legacyRow;
+
+	shared_ptr<const StreamCursors::Rows> traderRows = _traderRows[characterId].lock();
+	if (!traderRows)
 	{
-		Sqf::Parameters retVal = _srvObjects.front();
-		_srvObjects.pop();
+		//forget the menus nobody is streaming anymore
+		for (auto it=_traderRows.begin(); it!=_traderRows.end();)
+		{
+			if (it->second.expired())
+				it = _traderRows.erase(it);
+			else
+				++it;
+		}
 
-		return retVal;
+		auto newRows = make_shared<StreamCursors::Rows>();
+		_objData->populateTraderObjects(characterId, *newRows);
+		traderRows = newRows;
+		_traderRows[characterId] = traderRows;
 	}
+
+	string token = _cursors.open(traderRows);
+	_legacyTraderCursors[characterId] = token;
+
+	Sqf::Parameters retVal;
+	retVal.push_back(string("ObjectStreamStart"));
+	retVal.push_back(static_cast<int>(traderRows->size()));
+	retVal.push_back(token);
+	return retVal;
 }
 
 Sqf::Value HiveExtApp::tradeObject( Sqf::Parameters params )
@@ -499,34 +679,31 @@ Sqf::Value HiveExtApp::playerUpdate( Sqf::Parameters params )
 	{
 		if (!Sqf::IsNull(params.at(1)))
 		{
-			Sqf::Parameters worldSpaceArr = boost::get<Sqf::Parameters>(params.at(1));
+			Sqf::Parameters& worldSpaceArr = boost::get<Sqf::Parameters>(params.at(1));
 			if (worldSpaceArr.size() > 0)
 			{
-				Sqf::Value worldSpace = worldSpaceArr;
-				fields["Worldspace"] = worldSpace;
+				fields.set(CharDataSource::CHAR_WORLDSPACE,Sqf::Value(std::move(worldSpaceArr)));
 			}
 		}
 		if (!Sqf::IsNull(params.at(2)))
 		{
-			Sqf::Parameters inventoryArr = boost::get<Sqf::Parameters>(params.at(2));
+			Sqf::Parameters& inventoryArr = boost::get<Sqf::Parameters>(params.at(2));
 			if (inventoryArr.size() > 0)
 			{
-				Sqf::Value inventory = inventoryArr;
-				fields["Inventory"] = inventory;
+				fields.set(CharDataSource::CHAR_INVENTORY,Sqf::Value(std::move(inventoryArr)));
 			}
 		}
 		if (!Sqf::IsNull(params.at(3)))
 		{
-			Sqf::Parameters backpackArr = boost::get<Sqf::Parameters>(params.at(3));
+			Sqf::Parameters& backpackArr = boost::get<Sqf::Parameters>(params.at(3));
 			if (backpackArr.size() > 0)
 			{
-				Sqf::Value backpack = backpackArr;
-				fields["Backpack"] = backpack;
+				fields.set(CharDataSource::CHAR_BACKPACK,Sqf::Value(std::move(backpackArr)));
 			}
 		}
 		if (!Sqf::IsNull(params.at(4)))
 		{
-			Sqf::Parameters medicalArr = boost::get<Sqf::Parameters>(params.at(4));
+			Sqf::Parameters& medicalArr = boost::get<Sqf::Parameters>(params.at(4));
 			if (medicalArr.size() > 0)
 			{
 				for (size_t i=0;i<medicalArr.size();i++)
@@ -537,73 +714,68 @@ Sqf::Value HiveExtApp::playerUpdate( Sqf::Parameters params )
 						medicalArr[i] = Sqf::Parameters();
 					}
 				}
-				Sqf::Value medical = medicalArr;
-				fields["Medical"] = medical;
+				fields.set(CharDataSource::CHAR_MEDICAL,Sqf::Value(std::move(medicalArr)));
 			}
 		}
 		if (!Sqf::IsNull(params.at(5)))
 		{
 			bool justAte = boost::get<bool>(params.at(5));
-			if (justAte) fields["JustAte"] = true;
+			if (justAte) fields.set(CharDataSource::CHAR_JUSTATE,true);
 		}
 		if (!Sqf::IsNull(params.at(6)))
 		{
 			bool justDrank = boost::get<bool>(params.at(6));
-			if (justDrank) fields["JustDrank"] = true;
+			if (justDrank) fields.set(CharDataSource::CHAR_JUSTDRANK,true);
 		}
 		if (!Sqf::IsNull(params.at(7)))
 		{
 			int moreKillsZ = boost::get<int>(params.at(7));
-			if (moreKillsZ > 0) fields["KillsZ"] = moreKillsZ;
+			if (moreKillsZ > 0) fields.set(CharDataSource::CHAR_KILLSZ,moreKillsZ);
 		}
 		if (!Sqf::IsNull(params.at(8)))
 		{
 			int moreKillsH = boost::get<int>(params.at(8));
-			if (moreKillsH > 0) fields["HeadshotsZ"] = moreKillsH;
+			if (moreKillsH > 0) fields.set(CharDataSource::CHAR_HEADSHOTSZ,moreKillsH);
 		}
 		if (!Sqf::IsNull(params.at(9)))
 		{
 			int distanceWalked = static_cast<int>(Sqf::GetDouble(params.at(9)));
-			if (distanceWalked > 0) fields["DistanceFoot"] = distanceWalked;
+			if (distanceWalked > 0) fields.set(CharDataSource::CHAR_DISTANCEFOOT,distanceWalked);
 		}
 		if (!Sqf::IsNull(params.at(10)))
 		{
 			int durationLived = static_cast<int>(Sqf::GetDouble(params.at(10)));
-			if (durationLived > 0) fields["Duration"] = durationLived;
+			if (durationLived > 0) fields.set(CharDataSource::CHAR_DURATION,durationLived);
 		}
 		if (!Sqf::IsNull(params.at(11)))
 		{
-			Sqf::Parameters currentStateArr = boost::get<Sqf::Parameters>(params.at(11));
+			Sqf::Parameters& currentStateArr = boost::get<Sqf::Parameters>(params.at(11));
 			if (currentStateArr.size() > 0)
-			{
-				Sqf::Value currentState = currentStateArr;
-				fields["CurrentState"] = currentState;
-			}
+				fields.set(CharDataSource::CHAR_CURRENTSTATE,Sqf::Value(std::move(currentStateArr)));
 		}
 		if (!Sqf::IsNull(params.at(12)))
 		{
 			int moreKillsHuman = boost::get<int>(params.at(12));
-			if (moreKillsHuman > 0) fields["KillsH"] = moreKillsHuman;
+			if (moreKillsHuman > 0) fields.set(CharDataSource::CHAR_KILLSH,moreKillsHuman);
 		}
 		if (!Sqf::IsNull(params.at(13)))
 		{
 			int moreKillsBandit = boost::get<int>(params.at(13));
-			if (moreKillsBandit > 0) fields["KillsB"] = moreKillsBandit;
+			if (moreKillsBandit > 0) fields.set(CharDataSource::CHAR_KILLSB,moreKillsBandit);
 		}
 		if (!Sqf::IsNull(params.at(14)))
 		{
-			string newModel = boost::get<string>(params.at(14));
-			fields["Model"] = newModel;
+			fields.set(CharDataSource::CHAR_MODEL,Sqf::Value(std::move(boost::get<string>(params.at(14)))));
 		}
 		if (!Sqf::IsNull(params.at(15)))
 		{
 			int humanityDiff = static_cast<int>(Sqf::GetDouble(params.at(15)));
-			if (humanityDiff != 0) fields["Humanity"] = humanityDiff;
+			if (humanityDiff != 0) fields.set(CharDataSource::CHAR_HUMANITY,humanityDiff);
 		}
 		if (!Sqf::IsNull(params.at(16)))
 		{
 			int Money = static_cast<int>(Sqf::GetDouble(params.at(16)));
-			if (Money != 0) fields["Money"] = Money;
+			if (Money != 0) fields.set(CharDataSource::CHAR_MONEY,Money);
 		}
 	}
 	catch (const std::out_of_range&)
@@ -611,8 +783,8 @@ Sqf::Value HiveExtApp::playerUpdate( Sqf::Parameters params )
 		logger().warning("Update of character " + lexical_cast<string>(characterId) + " only had " + lexical_cast<string>(params.size()) + " parameters out of 17");
 	}
 
-	if (fields.size() > 0)
-		return ReturnBooleanStatus(_charData->updateCharacter(characterId,getServerId(),fields));
+	if (!fields.empty())
+		return ReturnBooleanStatus(_charData->updateCharacter(characterId,getServerId(),std::move(fields)));
 
 	return ReturnBooleanStatus(true);
 }
@@ -620,10 +792,10 @@ Sqf::Value HiveExtApp::playerUpdate( Sqf::Parameters params )
 Sqf::Value HiveExtApp::playerInit( Sqf::Parameters params )
 {
 	int characterId = Sqf::GetIntAny(params.at(0));
-	Sqf::Value inventory = boost::get<Sqf::Parameters>(params.at(1));
-	Sqf::Value backpack = boost::get<Sqf::Parameters>(params.at(2));
+	Sqf::Value inventory = std::move(boost::get<Sqf::Parameters>(params.at(1)));
+	Sqf::Value backpack = std::move(boost::get<Sqf::Parameters>(params.at(2)));
 
-	return ReturnBooleanStatus(_charData->initCharacter(characterId,inventory,backpack));
+	return ReturnBooleanStatus(_charData->initCharacter(characterId,std::move(inventory),std::move(backpack)));
 }
 
 Sqf::Value HiveExtApp::playerDeath( Sqf::Parameters params )
@@ -637,24 +809,28 @@ Sqf::Value HiveExtApp::playerDeath( Sqf::Parameters params )
 
 Sqf::Value HiveExtApp::streamCustom(Sqf::Parameters params)
 {
-	if (_custQueue.empty())
-	{
-		string query = Sqf::GetStringAny(params.at(0));
-		Sqf::Parameters rawParams = boost::get<Sqf::Parameters>(params.at(1));
-		_customData->populateQuery(query, rawParams, _custQueue);
-		Sqf::Parameters retVal;
-		retVal.push_back(string("CustomStreamStart"));
-		retVal.push_back(static_cast<int>(_custQueue.size()));
+	if (params.size() > 2)
+		return streamRow(Sqf::GetStringAny(params.at(2)));
 
-		return retVal;
-	}
-	else
-	{
-		Sqf::Parameters retVal = _custQueue.front();
-		_custQueue.pop();
+	Sqf::Value legacyRow;
+	if (legacyStreamRow(_legacyCustCursor,legacyRow))
+		return legacyRow;
 
-		return retVal;
-	}
+	string query = Sqf::GetStringAny(params.at(0));
+	Sqf::Parameters rawParams = boost::get<Sqf::Parameters>(params.at(1));
+
+	auto custRows = make_shared<StreamCursors::Rows>();
+	_customData->populateQuery(query, rawParams, *custRows);
+
+	int numRows = static_cast<int>(custRows->size());
+	_legacyCustCursor = _cursors.open(custRows);
+
+	Sqf::Parameters retVal;
+	retVal.push_back(string("CustomStreamStart"));
+	retVal.push_back(numRows);
+	retVal.push_back(_legacyCustCursor);
+
+	return retVal;
 }
 
 Sqf::Value HiveExtApp::customExecute(Sqf::Parameters params)
@@ -675,4 +851,28 @@ Sqf::Value HiveExtApp::serverShutdown( Sqf::Parameters params )
 	}
 
 	return ReturnBooleanStatus(false);
-}
\ No newline at end of file
+}
+
+#include "Database/Database.h"
+
+Sqf::Value HiveExtApp::databaseStatus( Sqf::Parameters params )
+{
+	UInt32 outageMs = 0;
+	size_t pendingOps = 0;
+
+	vector<Database*> dbs = getDatabases();
+	for (auto it=dbs.begin(); it!=dbs.end(); ++it)
+	{
+		UInt32 dbOutage = (*it)->outageDuration();
+		if (dbOutage > outageMs)
+			outageMs = dbOutage;
+
+		pendingOps += (*it)->pendingOperations();
+	}
+
+	Sqf::Parameters retVal;
+	retVal.push_back(string("PASS"));
+	retVal.push_back(static_cast<int>(outageMs/1000));
+	retVal.push_back(static_cast<int>(pendingOps));
+	return retVal;
+}
@@ -22,11 +22,13 @@
 #include "Shared/Server/AppServer.h"
 
 #include "Sqf.h"
+#include "StreamCursors.h"
 #include "DataSource/CharDataSource.h"
 #include "DataSource/ObjDataSource.h"
 #include "DataSource/CustomDataSource.h"
 
 #include <boost/function.hpp>
+#include <Poco/Timestamp.h>
 #include <boost/date_time.hpp>
 
 class Database;
@@ -63,6 +65,9 @@ protected:
 	unique_ptr<ObjDataSource> _objData;
 	unique_ptr<CustomDataSource> _customData;
 
+	//databases in use, for the outage metrics
+	virtual vector<Database*> getDatabases() const { return vector<Database*>(); }
+
 	string _initKey;
 private:
 	int _serverId;
@@ -74,12 +79,36 @@ private:
 
 	Sqf::Value getDateTime(Sqf::Parameters params);
 
-	ObjDataSource::ServerObjectsQueue _srvObjects;
-	CustomDataSource::CustomDataQueue _custQueue;
+	//time spent in each method on the calling (game) thread, in microseconds
+	struct MethodTiming
+	{
+		MethodTiming() : calls(0), total(0), longest(0) {}
+		UInt64 calls;
+		Poco::Timestamp::TimeDiff total;
+		Poco::Timestamp::TimeDiff longest;
+	};
+	map<int,MethodTiming> _timings;
+	void recordTiming(int funcNum, Poco::Timestamp::TimeDiff elapsed);
+	void logTimings();
+
+	//every stream gets its own cursor, scripts that don't pass the token get a default one per stream type
+	StreamCursors _cursors;
+	string _legacyObjCursor;
+	map<int,string> _legacyTraderCursors;
+	string _legacyCustCursor;
+	//rows of the trader menus being streamed, so concurrent streams of the same menu don't query again
+	map< int,weak_ptr<const StreamCursors::Rows> > _traderRows;
+
+	Sqf::Value streamRow(const string& token);
+	bool legacyStreamRow(string& token, Sqf::Value& outRow);
+	Sqf::Value streamCancel(Sqf::Parameters params);
+
 	Sqf::Value streamObjects(Sqf::Parameters params);
 
 	Sqf::Value objectPublish(Sqf::Parameters params);
 	Sqf::Value objectReturnId(Sqf::Parameters params);
+	Sqf::Value objectsNear(Sqf::Parameters params);
+	Sqf::Value objectsOwned(Sqf::Parameters params);
 	Sqf::Value objectInventory(Sqf::Parameters params, bool byUID = false);
 	Sqf::Value objectDelete(Sqf::Parameters params, bool byUID = false);
 	
@@ -91,10 +120,12 @@ private:
 	Sqf::Value loadCharacters(Sqf::Parameters params);
 	Sqf::Value loadPlayer(Sqf::Parameters params);
 	Sqf::Value loadCharacterDetails(Sqf::Parameters params);
+	Sqf::Value streamCharacterDetails(Sqf::Parameters params);
 	
 	Sqf::Value loadTraderDetails(Sqf::Parameters params);
 	Sqf::Value tradeObject(Sqf::Parameters params);
 	Sqf::Value datestampObjectUpdate(Sqf::Parameters params, bool byUID = false);
+	Sqf::Value datestampObjectsUpdate(Sqf::Parameters params, bool byUID = false);
 
 	Sqf::Value recordCharacterLogin(Sqf::Parameters params);
 
@@ -106,5 +137,6 @@ private:
 	Sqf::Value customExecute(Sqf::Parameters params);
 
 	Sqf::Value serverShutdown(Sqf::Parameters params);
+	Sqf::Value databaseStatus(Sqf::Parameters params);
 
 };
\ No newline at end of file
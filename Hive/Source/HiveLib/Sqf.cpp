@@ -298,6 +298,33 @@ namespace
 		}
 		template<typename T> bool operator()(T other) const { return other != 0; }
 	};
+
+	class LengthVisitor : public boost::static_visitor<size_t>
+	{
+	public:
+		//3 fractional digits at most, exponent notation from 1e5 up, like -1.235e-300
+		size_t operator()(double decVal) const { return 11; }
+		size_t operator()(int intVal) const { return (*this)(static_cast<Int64>(intVal)); }
+		size_t operator()(Int64 bigInt) const
+		{
+			size_t len = (bigInt < 0) ? 2 : 1;
+			for (; bigInt >= 10 || bigInt <= -10; bigInt /= 10)
+				len++;
+
+			return len;
+		}
+		size_t operator()(bool boolVal) const { return boolVal ? 4 : 5; }
+		size_t operator()(const string& str) const { return str.length() + 2; }
+		size_t operator()(void* ptr) const { return 3; } //any
+		size_t operator()(const Sqf::Parameters& arr) const
+		{
+			size_t len = (arr.size() > 0) ? (arr.size() + 1) : 2; //brackets and commas
+			for (auto it=arr.cbegin(); it!=arr.cend(); ++it)
+				len += boost::apply_visitor(*this,*it);
+
+			return len;
+		}
+	};
 };
 
 #include <boost/lexical_cast.hpp>
@@ -340,6 +367,11 @@ namespace Sqf
 		return boost::apply_visitor(BooleanVisitor(),val);
 	}
 
+	size_t SerializedLength(const Value& val)
+	{
+		return boost::apply_visitor(LengthVisitor(),val);
+	}
+
 	void runTest()
 	{
 		poco_assert(GetBoolAny(Value(true)) == true);
@@ -378,6 +410,7 @@ namespace Sqf
 		{
 			string out = lexical_cast<string>(*it);
 			poco_assert(out == testSamples[it-params.begin()]);
+			poco_assert(SerializedLength(*it) >= out.length());
 		}
 
 		string generatedParams = lexical_cast<string>(params);
@@ -33,6 +33,8 @@ namespace Sqf
 	Int64 GetBigInt(const Value& val);
 	string GetStringAny(const Value& val);
 	bool GetBoolAny(const Value& val);
+	//length of the value once serialized, without serializing it (decimals are counted at their longest)
+	size_t SerializedLength(const Value& val);
 
 	void runTest();
 }
@@ -0,0 +1,97 @@
+/*
+* Copyright (C) 2009-2012 Rajko Stojadinovic <http://github.com/rajkosto/hive>
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*/
+
+#include "StreamCursors.h"
+#include "Shared/Common/Timer.h"
+
+#include <Poco/HexBinaryEncoder.h>
+#include <Poco/RandomStream.h>
+#include <boost/array.hpp>
+
+StreamCursors::StreamCursors(UInt32 idleExpiry) : _idleExpiry(idleExpiry) {}
+
+string StreamCursors::makeToken()
+{
+	boost::array<UInt8,8> tokenData;
+	Poco::RandomInputStream().read((char*)tokenData.c_array(),tokenData.size());
+	std::ostringstream ostr;
+	//starts with a letter, so the script parser never takes it for a number
+	ostr << "S";
+	Poco::HexBinaryEncoder enc(ostr);
+	enc.rdbuf()->setLineLength(0);
+	enc.write((const char*)tokenData.data(),tokenData.size());
+	enc.close();
+	return ostr.str();
+}
+
+void StreamCursors::expireIdle()
+{
+	UInt32 now = GlobalTimer::getMSTime();
+	for (auto it=_cursors.begin(); it!=_cursors.end();)
+	{
+		if (GlobalTimer::getMSTimeDiff(it->second.lastUsed,now) > _idleExpiry)
+			it = _cursors.erase(it);
+		else
+			++it;
+	}
+}
+
+string StreamCursors::open(RowsPtr rows)
+{
+	expireIdle();
+
+	string token;
+	do { token = makeToken(); } while (_cursors.count(token) > 0);
+
+	Cursor& newCursor = _cursors[token];
+	newCursor.rows = std::move(rows);
+	newCursor.pos = 0;
+	newCursor.lastUsed = GlobalTimer::getMSTime();
+
+	return token;
+}
+
+StreamCursors::FetchResult StreamCursors::fetch(const string& token, Sqf::Parameters& outRow)
+{
+	expireIdle();
+
+	auto it = _cursors.find(token);
+	if (it == _cursors.end())
+		return FETCH_UNKNOWN;
+
+	Cursor& cursor = it->second;
+	if (!cursor.rows || cursor.pos >= cursor.rows->size())
+	{
+		_cursors.erase(it);
+		return FETCH_END;
+	}
+
+	outRow = (*cursor.rows)[cursor.pos++];
+	cursor.lastUsed = GlobalTimer::getMSTime();
+
+	//let go of the rows as soon as they've all been read, the cursor itself stays until it reports the end
+	if (cursor.pos >= cursor.rows->size())
+		cursor.rows.reset();
+
+	return FETCH_ROW;
+}
+
+bool StreamCursors::close(const string& token)
+{
+	return (_cursors.erase(token) > 0);
+}
\ No newline at end of file
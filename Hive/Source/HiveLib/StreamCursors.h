@@ -0,0 +1,66 @@
+/*
+* Copyright (C) 2009-2012 Rajko Stojadinovic <http://github.com/rajkosto/hive>
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*/
+
+#pragma once
+
+#include "Shared/Common/Types.h"
+#include "Sqf.h"
+
+//Independent read positions over shared, immutable row buffers
+//each cursor is identified by a token handed out to the script when the stream starts
+class StreamCursors
+{
+public:
+	typedef deque<Sqf::Parameters> Rows;
+	typedef shared_ptr<const Rows> RowsPtr;
+
+	//cursors not read from for this long (in ms) are dropped
+	StreamCursors(UInt32 idleExpiry = 5*60*1000);
+	~StreamCursors() {}
+
+	//makes a new cursor at the start of rows, returns its token
+	string open(RowsPtr rows);
+
+	enum FetchResult
+	{
+		FETCH_ROW,		//outRow contains the next row
+		FETCH_END,		//no more rows, the cursor has been closed
+		FETCH_UNKNOWN	//no such cursor (or it expired)
+	};
+	FetchResult fetch(const string& token, Sqf::Parameters& outRow);
+
+	//returns false if there was no such cursor
+	bool close(const string& token);
+
+	size_t numOpen() const { return _cursors.size(); }
+private:
+	//drops all cursors that have been idle for too long
+	void expireIdle();
+	static string makeToken();
+
+	struct Cursor
+	{
+		RowsPtr rows;
+		size_t pos;
+		UInt32 lastUsed;
+	};
+	typedef map<string,Cursor> CursorMap;
+	CursorMap _cursors;
+
+	UInt32 _idleExpiry;
+};
\ No newline at end of file